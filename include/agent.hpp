@@ -0,0 +1,33 @@
+#ifndef AGENT_HPP
+#define AGENT_HPP
+
+#include "password_entry.hpp"
+#include <string>
+#include <vector>
+
+class Vault;
+
+// key holding agent
+// keeps one unlocked vault in locked memory and answers
+// get/search/list over a unix socket only the owner can reach
+namespace Agent {
+  // idle seconds before agent exits and wipes the key
+  const int DEFAULT_TTL = 900;
+
+  // per user, per vault socket path
+  std::string socketPath(const std::string &vaultFile);
+
+  // detach and serve an open vault until idle ttl, stop request or vault change
+  // returns in the parent once the agent is listening,
+  // false if its memory could not be locked (RLIMIT_MEMLOCK)
+  bool start(Vault &vault, int ttlSeconds);
+
+  // send request to a running agent
+  // false if no agent is running for this vault or it could not answer
+  bool request(const std::string &vaultFile, const std::string &command, std::vector<PasswordEntry> &result);
+
+  // ask running agent to exit, false if none was running
+  bool stop(const std::string &vaultFile);
+}
+
+#endif
@@ -3,27 +3,35 @@
 
 #include <string>
 #include <vector>
+#include <string_view>
+#include "secure_memory.hpp"
+
+class PasswordEntry;
 
 namespace CLI {
   // cli output
   void showUsage();
   void showVersion();
   void showHelp(const std::string &command = "");
+  void showSessionHelp();
 
   // cli input
-  std::string readPassword(const std::string &prompt);
-  std::string readLine(const std::string &prompt);
+  SecureString readPassword(const std::string &prompt);
+  std::string readLine(std::string_view prompt);
   bool readYesNo(const std::string &prompt);
 
   // cli output full format
-  void displayPasswordTable(const std::vector<class PasswordEntry> &entries);
-  void displayPasswordDetail(const class PasswordEntry &entry);
+  void displayPasswordTable(const std::vector<PasswordEntry> &entries);
+  // same table over entries owned elsewhere (e.g. by the vault)
+  void displayPasswordTable(const std::vector<const PasswordEntry *> &entries);
+  void displayPasswordDetail(const PasswordEntry &entry);
 
   // helpers
   std::string formatDate(time_t timestamp);
   void clearScreen();
   void printSeparator(char ch = '=', int width = 50);
   void printError(const std::string &message);
+  void printWarning(const std::string &message);
   void printSuccess(const std::string &message);
   void printInfo(const std::string &message);
 }
@@ -0,0 +1,49 @@
+#ifndef CRYPTO_ENGINE_HPP
+#define CRYPTO_ENGINE_HPP
+
+#include <openssl/types.h>
+#include "cryptography.hpp"
+
+// process wide openssl state, set up once on first use
+// every CryptoManager is a handle to the same engine
+// the fetched algorithms are immutable, so any thread may use them at once
+class CryptoEngine {
+  private:
+    EVP_CIPHER *cbc;
+    EVP_CIPHER *gcm;
+    EVP_CIPHER *keyWrap;
+    EVP_MD *sha256;
+
+    // init openssl and fetch algorithms, runtime_error if one is missing
+    CryptoEngine();
+    // free fetched algorithms
+    void release();
+
+  public:
+    // at exit
+    ~CryptoEngine();
+
+    // delete when copy
+    CryptoEngine(const CryptoEngine &) = delete;
+    CryptoEngine &operator=(const CryptoEngine &) = delete;
+
+    // the engine, created on first call (thread safe)
+    static const CryptoEngine &instance();
+
+    // record cipher for a mode
+    const EVP_CIPHER *cipher(CipherMode mode) const {
+      return (mode == CipherMode::GCM) ? gcm : cbc;
+    }
+
+    // AES-256 key wrap (RFC 3394)
+    const EVP_CIPHER *wrapCipher() const {
+      return keyWrap;
+    }
+
+    // digest for key derivation
+    const EVP_MD *digest() const {
+      return sha256;
+    }
+};
+
+#endif
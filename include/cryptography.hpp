@@ -4,36 +4,92 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <span>
+#include <cstddef>
+#include <string_view>
+#include "secure_memory.hpp"
 
+// record cipher, chosen per vault and stored in its header
+enum class CipherMode : int {
+  // AES-256-CBC, padding only, no integrity
+  CBC = 0,
+  // AES-256-GCM, 16 byte tag appended to the ciphertext
+  GCM = 1
+};
+
+class CryptoEngine;
+
+// cheap handle to the process wide CryptoEngine
+// holds no openssl state of its own, so any number can exist at once
 class CryptoManager {
 private:
   // vars
+  const CryptoEngine* engine;
   static const int SALT_SIZE = 16;
   static const int IV_SIZE = 16;
   static const int KEY_SIZE = 32;
   static const int ITERATIONS = 100000;
+  // RFC 3394 adds one 8 byte integrity block
+  static const int WRAPPED_KEY_SIZE = KEY_SIZE + 8;
+  // GCM uses the first 12 bytes of the 16 byte iv
+  static const int GCM_NONCE_SIZE = 12;
+  static const int GCM_TAG_SIZE = 16;
+  static const int BLOCK_SIZE = 16;
 
 public:
-  // construct
+  // construct, first one in the process sets up openssl
   CryptoManager();
-  // desctruct
-  ~CryptoManager();
 
   // gen random salt value
   std::vector<uint8_t> generateSalt();
   
   // gen random IV value
   std::vector<uint8_t> generateIV();
+  // into caller buffer (16 bytes)
+  void generateIV(std::span<uint8_t> iv);
+  
+  // gen random data encryption key, in locked memory
+  SecureBytes generateKey();
+
+  // wrap key with key encryption key (AES-256 key wrap)
+  std::vector<uint8_t> wrapKey(std::span<const uint8_t> key, std::span<const uint8_t> kek);
+
+  // unwrap, fails if kek is wrong or wrapped key was modified
+  SecureBytes unwrapKey(const std::vector<uint8_t>& wrapped, std::span<const uint8_t> kek);
   
   // derive encryption key from password
   // use PBKDF2
-  std::vector<uint8_t> deriveKey(const std::string& password, const std::vector<uint8_t>& salt);
+  SecureBytes deriveKey(std::string_view password, const std::vector<uint8_t>& salt);
   
-  // encrypt with AES-256-CBC
-  std::vector<uint8_t> encrypt(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv);
+  // encrypt with AES-256 (CBC unless mode says otherwise)
+  // GCM also authenticates aad, CBC ignores it
+  std::vector<uint8_t> encrypt(std::span<const uint8_t> plaintext, std::span<const uint8_t> key, const std::vector<uint8_t>& iv,
+                               CipherMode mode = CipherMode::CBC, std::span<const uint8_t> aad = {});
   
-  // decrypt
-  std::vector<uint8_t> decrypt(const std::vector<uint8_t>& encryptedtext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv);
+  // decrypt, GCM throws if the ciphertext, tag or aad do not match
+  std::vector<uint8_t> decrypt(const std::vector<uint8_t>& encryptedtext, std::span<const uint8_t> key, const std::vector<uint8_t>& iv,
+                               CipherMode mode = CipherMode::CBC, std::span<const uint8_t> aad = {});
+
+  // decrypt straight from a view (e.g. a mapped file), no copy of the input
+  std::vector<uint8_t> decrypt(std::span<const uint8_t> encryptedtext, std::span<const uint8_t> key, std::span<const uint8_t> iv,
+                               CipherMode mode = CipherMode::CBC, std::span<const uint8_t> aad = {});
+
+  // allocation free versions for hot paths: write into out, return bytes written
+  // reuse one cipher context per thread, re-keyed when the key buffer changes or releaseCachedKeys() ran
+  // out must hold encryptedSize() / maxDecryptedSize() bytes
+  size_t encrypt(std::span<const uint8_t> plaintext, std::span<const uint8_t> key, std::span<const uint8_t> iv,
+                 std::span<uint8_t> out, CipherMode mode, std::span<const uint8_t> aad = {});
+  size_t decrypt(std::span<const uint8_t> encryptedtext, std::span<const uint8_t> key, std::span<const uint8_t> iv,
+                 std::span<uint8_t> out, CipherMode mode, std::span<const uint8_t> aad = {});
+
+  // call whenever a key buffer is wiped or given a new key
+  // the per thread contexts above remember only the key's address, this makes them re-key,
+  // and resets the calling thread's context so its key schedule is cleansed
+  static void releaseCachedKeys();
+
+  // buffer sizes for the span versions
+  static size_t encryptedSize(size_t plaintextSize, CipherMode mode);
+  static size_t maxDecryptedSize(size_t encryptedSize, CipherMode mode);
   
   // wipe
   void wipe(void* ptr, size_t size);
@@ -0,0 +1,132 @@
+#ifndef ENTRY_STORE_HPP
+#define ENTRY_STORE_HPP
+
+#include "password_entry.hpp"
+#include "trigram_index.hpp"
+#include "query.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// index fields of every entry as columns (struct of arrays)
+// the only in-memory copy of them, PasswordEntry views are built on demand
+// scans read only the columns they test, front to back, with no pointer chasing
+// slots are dense: removing an entry moves the last slot into its place
+class EntryStore {
+  private:
+    // ids below this map to slots through a flat table, others through a hash map
+    static constexpr int DENSE_ID_LIMIT = 1 << 22;
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    // variable length strings: one byte buffer plus offset and length per slot
+    // replaced and removed values leave dead bytes, packed once they dominate
+    struct TextColumn {
+      std::string bytes;
+      std::vector<uint32_t> offsets;
+      std::vector<uint32_t> lengths;
+      // bytes still referenced by a slot
+      size_t live = 0;
+
+      std::string_view at(size_t slot) const {
+        return std::string_view(bytes.data() + offsets[slot], lengths[slot]);
+      }
+      void append(std::string_view value);
+      void set(size_t slot, std::string_view value);
+      // last slot moves into the hole
+      void remove(size_t slot);
+      void clear();
+      void pack();
+    };
+
+    // slot -> id, and id -> slot
+    std::vector<int> ids;
+    std::vector<uint32_t> denseSlots;
+    std::unordered_map<int, uint32_t> sparseSlots;
+
+    // columns
+    TextColumn service;
+    TextColumn username;
+    TextColumn url;
+    std::vector<uint32_t> category;
+    std::vector<int64_t> created;
+    std::vector<int64_t> modified;
+    std::vector<int> strength;
+
+    // interned category names, id is the index
+    std::vector<std::string> categoryNames;
+    std::unordered_map<std::string, uint32_t> categoryIds;
+    // ids in each category, ascending, indexed like categoryNames
+    std::vector<std::vector<int>> categoryMembers;
+
+    // every id ordered by service, then id
+    // sorted by the first listing that needs it, then kept in order by put and remove
+    mutable std::vector<int> serviceOrder;
+    mutable std::atomic<bool> serviceOrderBuilt = false;
+
+    // (time, id) pairs in time order, ties by id
+    using TimeOrder = std::vector<std::pair<int64_t, int>>;
+    // created and modified times of every id, sorted by the first range query
+    // then kept in order by put and remove
+    mutable TimeOrder createdOrder;
+    mutable TimeOrder modifiedOrder;
+    mutable std::atomic<bool> timeOrderBuilt = false;
+
+    // trigrams of service, username, url and category
+    // built by the first query that can use it, then kept up to date by put and remove
+    mutable TrigramIndex trigrams;
+    mutable std::atomic<bool> trigramsBuilt = false;
+
+    // held while a const query builds a lazy index, so concurrent readers build it once
+    mutable std::mutex buildLock;
+
+    uint32_t slotOf(int id) const;
+    void setSlot(int id, uint32_t slot);
+    uint32_t intern(const std::string& name);
+    // ids of the given slots, sorted so results come out in id order
+    std::vector<int> sortedIds(std::vector<uint32_t>& slots) const;
+    void buildTrigrams() const;
+    // position of (name, id) in serviceOrder
+    std::vector<int>::iterator serviceOrderAt(std::string_view name, int id) const;
+    const TimeOrder& timeOrder(Query::Field field) const;
+    // pairs with from <= time < to
+    static std::pair<TimeOrder::const_iterator, TimeOrder::const_iterator> timeRange(const TimeOrder& order, int64_t from, int64_t to);
+
+  public:
+    // insert, or replace the entry with the same id
+    void put(const PasswordEntry& entry);
+    // drop id, nothing happens if it is not stored
+    void remove(int id);
+    void clear();
+    size_t size() const {
+      return ids.size();
+    }
+    bool contains(int id) const {
+      return slotOf(id) != NO_SLOT;
+    }
+    // index only view of a stored id
+    PasswordEntry entry(int id) const;
+    // every stored id, ascending
+    std::vector<int> allIds() const;
+
+    // every id ordered by service, ties by id
+    const std::vector<int>& orderedByService() const;
+    // ids with from <= modified < to, least recently changed first
+    std::vector<int> modifiedBetween(int64_t from, int64_t to) const;
+    // ids matching every clause of query, ascending
+    // candidates come from the category, time or trigram index when a clause allows it
+    std::vector<int> select(const Query& query) const;
+    // up to limit ids whose service or url approximately contains query, best first
+    // ties go to the service field, then to the lower id
+    std::vector<int> matchFuzzy(std::string_view query, size_t limit) const;
+    // entries per category name, "" for none
+    std::map<std::string, int> countByCategory() const;
+};
+
+#endif
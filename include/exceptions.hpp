@@ -42,6 +42,12 @@ class InvalidPasswordException : public CustomException {
     explicit InvalidPasswordException(const std::string &msg = "Invalid password") : CustomException(msg) {}
 };
 
+// exception for a malformed search query
+class QueryException : public CustomException {
+  public:
+    explicit QueryException(const std::string &msg) : CustomException("Query Error: " + msg) {}
+};
+
 // exception for a corrupted vault
 class CorruptedVaultException : public CustomException {
   public:
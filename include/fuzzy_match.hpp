@@ -0,0 +1,68 @@
+#ifndef FUZZY_MATCH_HPP
+#define FUZZY_MATCH_HPP
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <optional>
+#include <span>
+#include <cstdint>
+
+// approximate substring matching with Myers' bit-parallel edit distance
+// one 64 bit word per pattern, so one step per text byte, ascii case is ignored
+class FuzzyMatcher {
+  public:
+    // longer patterns are cut to this many bytes
+    static constexpr size_t MAX_PATTERN = 64;
+    // texts matched side by side by the batch calls
+    static constexpr size_t LANES = 4;
+
+    explicit FuzzyMatcher(std::string_view pattern);
+
+    // edits a match may need: none below 3 bytes, then one per 3 pattern bytes
+    int maxErrors() const {
+      return allowed;
+    }
+    // fewest edits turning the pattern into some substring of text, and where that substring starts
+    // nullopt if it needs more than maxErrors()
+    struct Match {
+      int distance;
+      size_t start;
+    };
+    std::optional<Match> match(std::string_view text) const;
+    // same for many texts, results[i] belongs to texts[i]
+    // one step is a chain of dependent operations, batches run LANES of those chains at once
+    void match(std::span<const std::string_view> texts, std::span<std::optional<Match>> results) const;
+
+    // rank of a match in text, higher is better: fewer edits, then a match at the start of
+    // text or of a word in it, then an exact whole text match, then shorter text
+    // one edit more always ranks lower, whatever the rest
+    int rank(std::string_view text, const Match& found) const;
+    std::optional<int> score(std::string_view text) const;
+
+    // cheap filter before match(): false if text surely needs more than maxDistance edits
+    // every pattern byte that does not occur in text at all costs one edit
+    bool mayMatch(std::string_view text, int maxDistance) const;
+
+  private:
+    // bit i set where pattern byte i equals the text byte, either case
+    std::array<uint64_t, 256> peq{};
+    size_t length;
+    int allowed;
+
+    // Myers state of one text: vertical deltas of the last column, current and best distance
+    struct Column {
+      uint64_t pv;
+      uint64_t mv;
+      int distance;
+      int best;
+      size_t end;
+    };
+
+    Column startColumn() const;
+    static void step(Column& column, uint64_t eq, uint64_t high, size_t j);
+    // run column over text from byte from to the end, then judge its best distance
+    std::optional<Match> finish(std::string_view text, Column& column, size_t from) const;
+};
+
+#endif
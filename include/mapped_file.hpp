@@ -0,0 +1,45 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// read only memory map of a whole file
+// every access is checked against the file size
+class MappedFile {
+  private:
+    const uint8_t *data;
+    size_t length;
+
+  public:
+    // map file, FileException if it cannot be opened or mapped
+    explicit MappedFile(const std::string &path);
+    // unmap
+    ~MappedFile();
+
+    // delete when copy
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // bytes [offset, offset + count), CorruptedVaultException if past the end
+    std::span<const uint8_t> span(size_t offset, size_t count) const;
+
+    // read a plain value at offset, same bounds check as span()
+    template <typename T>
+    T read(size_t offset) const {
+      T value;
+      std::span<const uint8_t> bytes = span(offset, sizeof(T));
+      std::memcpy(&value, bytes.data(), sizeof(T));
+      return value;
+    }
+
+    // file size
+    size_t size() const {
+      return length;
+    }
+};
+
+#endif
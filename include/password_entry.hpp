@@ -2,26 +2,36 @@
 #define PASSWORD_ENTRY_HPP
 
 #include <string>
+#include <string_view>
+#include <cstdint>
 #include <ctime>
 #include <iostream>
+#include "secure_memory.hpp"
 
 class PasswordEntry {
 private:
   int id;
   std::string service;
   std::string username;
-  std::string password;
+  // secrets live in locked memory
+  SecureString password;
   std::string url;
-  std::string notes;
+  SecureString notes;
   std::string category;
   time_t created;
   time_t last_modified;
+  // cached so the index view can show it without the password
+  int strength;
+  // false for index-only entries (password and notes not decrypted)
+  bool secretsLoaded;
 
 public:
   // construct
   PasswordEntry();
-  PasswordEntry(int id, const std::string& service, const std::string& username, const std::string& password);
+  PasswordEntry(int id, const std::string& service, const std::string& username, std::string_view password);
   PasswordEntry(const PasswordEntry& other);
+  // moved from entry is left empty, its password buffer wiped
+  PasswordEntry(PasswordEntry&& other) noexcept;
   
   // destruct
   ~PasswordEntry();
@@ -30,22 +40,22 @@ public:
   int getId() const {
     return id;
   }
-  std::string getService() const {
+  const std::string& getService() const {
     return service;
   }
-  std::string getUsername() const {
+  const std::string& getUsername() const {
     return username;
   }
-  std::string getPassword() const {
+  const SecureString& getPassword() const {
     return password;
   }
-  std::string getUrl() const {
+  const std::string& getUrl() const {
     return url;
   }
-  std::string getNotes() const {
+  const SecureString& getNotes() const {
     return notes;
   }
-  std::string getCategory() const {
+  const std::string& getCategory() const {
     return category;
   }
   time_t getCreated() const {
@@ -54,6 +64,12 @@ public:
   time_t getModified() const {
     return last_modified;
   }
+  int getStrength() const {
+    return strength;
+  }
+  bool hasSecrets() const {
+    return secretsLoaded;
+  }
   
   // setters
   void setId(int newId) {
@@ -68,15 +84,12 @@ public:
     username = u;
     updateModified();
   }
-  void setPassword(const std::string& p) {
-    password = p;
-    updateModified();
-  }
+  void setPassword(std::string_view p);
   void setUrl(const std::string& u) {
     url = u;
     updateModified();
   }
-  void setNotes(const std::string& n) {
+  void setNotes(std::string_view n) {
     notes = n;
     updateModified();
   }
@@ -87,6 +100,7 @@ public:
   
   // = operator
   PasswordEntry& operator=(const PasswordEntry& other);
+  PasswordEntry& operator=(PasswordEntry&& other) noexcept;
   
   // == operator
   bool operator==(const PasswordEntry& other) const;
@@ -101,9 +115,32 @@ public:
   void updateModified();
   std::string toString() const;
   
-  // serials
-  std::string serialize() const;
-  static PasswordEntry deserialize(const std::string& data);
+  // first byte of every binary record, text records start with a digit
+  static const uint8_t BINARY_FORMAT = 1;
+
+  // serials, binary: varint length before each string, 8 byte times
+  // deserialize also takes the older '|' text format, split records are binary only
+  SecureString serialize() const;
+  static PasswordEntry deserialize(std::string_view data);
+
+  // split serials: index (everything list/search need) and secrets (password, notes)
+  std::string serializeIndex() const;
+  SecureString serializeSecrets() const;
+  static PasswordEntry deserializeIndex(std::string_view data);
+  void loadSecrets(std::string_view data);
+  // drop password and notes, keeping the index fields
+  PasswordEntry withoutSecrets() const;
+  // index only entry built from its fields, password and notes never set
+  static PasswordEntry indexOnly(int id, std::string_view service, std::string_view username, std::string_view url,
+                                 std::string_view category, time_t created, time_t modified, int strength);
+
+private:
+  // zero a string's whole buffer, then empty it
+  // (the arena wipes heap buffers, this covers short strings kept inline)
+  static void wipe(SecureString& value) noexcept;
+
+  // text format reader for records written before the binary format
+  static PasswordEntry deserializeText(std::string_view data);
 };
 
 #endif
@@ -3,6 +3,10 @@
 
 #include <string>
 #include <vector>
+#include <string_view>
+#include <span>
+#include <cstddef>
+#include "secure_memory.hpp"
 
 class PasswordGenerator {
 private:
@@ -13,13 +17,17 @@ private:
 
 public:
   // gen password, default
-  static std::string generate(int length = 16);
+  static SecureString generate(int length = 16);
 
   // gen password custom character fields
-  static std::string generate(int length, bool useLowercase, bool useUppercase, bool useDigits, bool useSymbols);
+  static SecureString generate(int length, bool useLowercase, bool useUppercase, bool useDigits, bool useSymbols);
+
+  // count passwords from every character set, each followed by '\n', in one buffer
+  // threads workers fill their own slices of it
+  static SecureString generateMany(size_t count, int length = 16, unsigned threads = 1);
 
   // calculate password strength
-  static int calculateStrength(const std::string &password);
+  static int calculateStrength(std::string_view password);
 
   // get description of strength based on calculateStrength() return
   static std::string getStrengthDescription(int strength);
@@ -27,6 +35,9 @@ public:
 private:
   // getter
   static std::string getCharacterSet(bool useLowercase, bool useUppercase, bool useDigits, bool useSymbols);
+
+  // fill out with chars drawn uniformly from charset (at most 256 of them)
+  static void fillFromCharset(std::span<char> out, std::string_view charset);
 };
 
 #endif
@@ -0,0 +1,61 @@
+#ifndef QUERY_HPP
+#define QUERY_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ctime>
+#include <cstdint>
+
+// filter expression over entry index fields, every term must hold
+//   github              service, username, url or category contains github
+//   user~admin          field contains text, case ignored
+//   category:work       field equals text, case ignored ("=" works too)
+//   strength<60         numeric compare: < <= > >= : =
+//   modified<90d        changed less than 90 days ago (h, d, w, y)
+//   created>1y          created more than a year ago
+//   modified<2025-01-01 changed before that date
+// fields: service, user, url, category, strength, created, modified
+// "double quotes" keep spaces inside a term
+class Query {
+  public:
+    enum class Field {
+      Any,
+      Service,
+      Username,
+      Url,
+      Category,
+      Strength,
+      Created,
+      Modified
+    };
+    enum class Op {
+      Contains,
+      Equals,
+      Less,
+      LessEqual,
+      Greater,
+      GreaterEqual
+    };
+    // times are absolute: modified<90d becomes modified > now - 90 days
+    struct Clause {
+      Field field;
+      Op op;
+      std::string text;
+      int64_t number = 0;
+    };
+
+    // throws QueryException on a malformed term
+    static Query parse(std::string_view expression, time_t now = time(nullptr));
+    // "90d" style age in seconds (h, d, w, y), throws QueryException
+    static int64_t ageSeconds(std::string_view text);
+
+    const std::vector<Clause>& clauses() const {
+      return terms;
+    }
+
+  private:
+    std::vector<Clause> terms;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SECURE_MEMORY_HPP
+#define SECURE_MEMORY_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+
+// memory for secrets: locked out of swap, left out of core dumps, wiped on free
+// small blocks come from 1 MB arenas with a guard page on each side,
+// carved out by bump pointer and recycled through per size free lists
+// blocks past the largest size class get their own guarded mapping
+class SecureArena {
+  public:
+    // bytes mapped per arena
+    static constexpr size_t ARENA_SIZE = 1024 * 1024;
+    // smallest and largest size class, powers of two in between
+    static constexpr size_t MIN_BLOCK = 16;
+    static constexpr size_t MAX_BLOCK = 4096;
+
+    // block of at least size bytes, std::bad_alloc when nothing can be mapped
+    static void *allocate(size_t size);
+    // wipe and hand back a block from allocate() with the same size
+    static void deallocate(void *block, size_t size) noexcept;
+
+    // true while every arena mapped so far is locked (mlock can hit RLIMIT_MEMLOCK)
+    static bool isLocked();
+    // bytes handed out and not yet freed
+    static size_t inUse();
+};
+
+// std allocator over SecureArena
+template <typename T>
+struct secure_allocator {
+  using value_type = T;
+
+  secure_allocator() noexcept = default;
+  template <typename U>
+  secure_allocator(const secure_allocator<U> &) noexcept {
+  }
+
+  T *allocate(size_t count) {
+    if (count > SIZE_MAX / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    return static_cast<T*>(SecureArena::allocate(count * sizeof(T)));
+  }
+
+  void deallocate(T *block, size_t count) noexcept {
+    SecureArena::deallocate(block, count * sizeof(T));
+  }
+
+  // every instance shares the one arena
+  template <typename U>
+  bool operator==(const secure_allocator<U> &) const noexcept {
+    return true;
+  }
+};
+
+// strings and buffers holding passwords, notes and keys
+// strings short enough for the inline buffer never reach the arena,
+// PasswordEntry wipes those itself
+using SecureString = std::basic_string<char, std::char_traits<char>, secure_allocator<char>>;
+using SecureBytes = std::vector<uint8_t, secure_allocator<uint8_t>>;
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef SECURE_RANDOM_HPP
+#define SECURE_RANDOM_HPP
+
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+// cryptographically secure random bytes from a per thread buffer
+// the buffer is refilled from RAND_bytes a few KB at a time, so small
+// requests (ivs, salts, password chars) skip the DRBG lock per call
+// bytes are wiped once handed out, and the buffer is dropped after fork()
+class SecureRandom {
+  public:
+    // bytes refilled at once
+    static const size_t BUFFER_SIZE = 4096;
+
+    // fill out with random bytes, runtime_error if openssl fails
+    // requests of BUFFER_SIZE or more go straight to RAND_bytes
+    static void fill(std::span<uint8_t> out);
+
+    // uniform value in [0, bound), rejection sampled so there is no modulo bias
+    static uint32_t uniform(uint32_t bound);
+
+    // wipe this thread's unused bytes now (also done at thread exit)
+    static void release();
+};
+
+#endif
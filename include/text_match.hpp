@@ -0,0 +1,26 @@
+#ifndef TEXT_MATCH_HPP
+#define TEXT_MATCH_HPP
+
+#include <string_view>
+
+// ascii case-insensitive substring search, compared in place without lower-cased copies
+// vector kernels test 16 or 32 candidate positions per step on the first and last query byte
+namespace TextMatch {
+  enum class Kernel {
+    Scalar,
+    SSE2,
+    AVX2
+  };
+
+  // fastest kernel this cpu supports, picked once
+  Kernel best();
+  bool supported(Kernel kernel);
+  const char* name(Kernel kernel);
+
+  // true if query occurs in text, ascii letters compared without case
+  bool containsIgnoreCase(std::string_view text, std::string_view query);
+  // same with a given kernel, which must be supported
+  bool containsIgnoreCase(std::string_view text, std::string_view query, Kernel kernel);
+}
+
+#endif
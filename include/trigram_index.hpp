@@ -0,0 +1,40 @@
+#ifndef TRIGRAM_INDEX_HPP
+#define TRIGRAM_INDEX_HPP
+
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <initializer_list>
+#include <optional>
+#include <cstdint>
+
+// inverted index from lower-cased 3 byte substrings to the ids containing them
+// a query's trigrams narrow the search to a candidate set, which the caller then verifies
+class TrigramIndex {
+  public:
+    static constexpr size_t GRAM = 3;
+    using Fields = std::initializer_list<std::string_view>;
+
+    // index id under the trigrams of every field
+    void add(int id, Fields fields);
+    // unindex id, fields must be the ones it was added with
+    void remove(int id, Fields fields);
+    // move id from old to new field values, only changed trigrams are touched
+    void update(int id, Fields oldFields, Fields newFields);
+    void clear();
+
+    // ids that contain every trigram of query, in ascending order
+    // nullopt if query is too short to narrow anything down
+    std::optional<std::vector<int>> candidates(std::string_view query) const;
+
+  private:
+    // posting lists, ids sorted ascending
+    std::unordered_map<uint32_t, std::vector<int>> postings;
+
+    // distinct trigrams over all fields, sorted
+    static std::vector<uint32_t> gramsOf(Fields fields);
+    void insert(uint32_t gram, int id);
+    void erase(uint32_t gram, int id);
+};
+
+#endif
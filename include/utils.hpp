@@ -4,6 +4,10 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include "secure_memory.hpp"
 
 // helper functions
 namespace Utils {
@@ -16,8 +20,18 @@ namespace Utils {
   // convert bytes to hex string (for display)
   std::string bytesToHex(const std::vector<uint8_t>& bytes);
   
+  // ascii case insensitive substring test, an empty query matches everything
+  bool containsIgnoreCase(std::string_view text, std::string_view query);
+
   // read password from stdin (without echo)
-  std::string readPassword(const std::string& input);
+  SecureString readPassword(const std::string& input);
+
+  // worker count to use when none is configured (core count, at least 1)
+  unsigned defaultThreads();
+
+  // run work(begin, end) over [0, count) split into chunks of grain across threads
+  // first exception thrown by any chunk is rethrown once all workers stop
+  void parallelFor(size_t count, unsigned threads, const std::function<void(size_t, size_t)>& work, size_t grain = 256);
 }
 
 #endif
@@ -4,11 +4,19 @@
 #include "password_entry.hpp"
 #include "cryptography.hpp"
 #include "exceptions.hpp"
+#include "entry_store.hpp"
 #include <string>
+#include <string_view>
 #include <map>
 #include <vector>
 #include <memory>
+#include <optional>
 #include <cstdint>
+#include <span>
+#include <array>
+#include <functional>
+
+class MappedFile;
 
 class Vault {
   private:
@@ -17,36 +25,138 @@ class Vault {
     static const int SALT_SIZE = 16;
     static const int HASH_SIZE = 32;
     static const int HEADER_SIZE = 128;
+    static const int WRAPPED_KEY_SIZE = 40;
+    // v1: key derived from password encrypts entries
+    // v2: random data key, wrapped by derived key and stored in header
+    static const int CURRENT_VERSION = 2;
+    // journal is folded into the snapshot once it passes this size
+    // and is at least half as large as the snapshot itself
+    static const long JOURNAL_COMPACT_MIN_BYTES = 64 * 1024;
+    static constexpr char JOURNAL_PUT = 'P';
+    static constexpr char JOURNAL_DELETE = 'D';
+    // header flags, v2 only (v1 reserved space is zero)
+    // split: each entry is an index record followed by a secrets record
+    static const int FLAG_SPLIT_RECORDS = 1;
+    // offset table: record after the entries mapping id to index record offset
+    static const int FLAG_OFFSET_TABLE = 2;
+    static const size_t OFFSET_TABLE_ENTRY_SIZE = sizeof(int) + sizeof(int64_t);
+
+    // what a record holds, authenticated with its position under GCM
+    // index: entry ordinal, secrets: entry id, journal: byte offset in journal
+    enum RecordRole {
+      ROLE_COUNT = 1,
+      ROLE_INDEX = 2,
+      ROLE_SECRETS = 3,
+      ROLE_TABLE = 4,
+      ROLE_JOURNAL = 5
+    };
+    // entries per buffer handed from save() workers to the writer
+    static const size_t SAVE_CHUNK_ENTRIES = 512;
+
+    // view of one record in a mapped vault file
+    struct Record {
+      std::span<const uint8_t> iv;
+      std::span<const uint8_t> data;
+      // offset just past the record
+      size_t end;
+    };
+
+    // encrypted password and notes of one entry
+    struct SealedSecrets {
+      std::vector<uint8_t> iv;
+      std::vector<uint8_t> data;
+    };
 
     std::string filename;
     std::string master_password_hash;
     std::vector<uint8_t> salt;
-    std::vector<uint8_t> encryption_key;
+    // data key (v1: password derived key), in locked memory
+    SecureBytes encryption_key;
+    std::vector<uint8_t> wrapped_key;
+    int version;
     int iterations;
+    int flags;
+    // file offset of the offset table record, 0 if there is none
+    int64_t tableOffset;
+    // cipher save() writes, and cipher of the file and sealed records now
+    CipherMode cipherMode;
+    CipherMode fileMode;
     bool isOpen;
+    // worker threads for decrypting on open, 0 = one per core
+    unsigned threads;
     
     std::unique_ptr<CryptoManager> cryptography;
-    std::map<int, PasswordEntry> entries;
+    // index fields by column, the one copy every lookup and scan reads
+    EntryStore columns;
+    // secrets stay encrypted until asked for
+    std::map<int, SealedSecrets> secrets;
     int nextId;
 
+    // append-only log of mutations since the last snapshot
+    bool journaling;
+    long journalBytes;
+    long snapshotBytes;
+    // durable writes (snapshot or journal) since construction
+    long writeCount;
+
+    // batch in progress: mutations stay in memory until commit
+    // undo holds each touched entry as it was before the batch (empty if new)
+    bool inBatch;
+    int batchNextId;
+    std::map<int, std::optional<PasswordEntry>> undo;
+
     // write header to file
-    void writeHeader(std::ofstream &file);
+    void writeHeader(std::ostream &file);
     // read header
-    void readHeader(std::ifstream &file);
+    void readHeader(const MappedFile &file);
+    // record at offset, bounds checked
+    static Record readRecord(const MappedFile &file, size_t offset);
+    // associated data binding a record to its role and position
+    using AssociatedData = std::array<uint8_t, sizeof(int) + sizeof(int64_t)>;
+    static AssociatedData associatedData(RecordRole role, int64_t position);
 
     // hash password
-    std::vector<uint8_t> hashPassword(const std::string &password);
+    std::vector<uint8_t> hashPassword(std::string_view password);
     // check password against hash
-    void verifyPassword(const std::string &password);
-
-    // convert before encrypyt
-    std::vector<uint8_t> serializeEntries();
-    // decrypt back into object to return
-    void deserializeEntries(const std::vector<uint8_t> &data);
+    void verifyPassword(std::string_view password);
+    // derive key from password, unwrap data key for v2
+    void unlockKey(std::string_view password);
+    // wipe the data key and make every cached cipher context forget it
+    void wipeKey();
+    // new random data key wrapped under password derived key
+    void generateWrappedKey(const SecureBytes &kek);
 
     // copy magic number to buffer
     void copyMagicNumber(char *dest, const char *src);
 
+    // full write of the vault file, save() and commit() share it
+    void writeSnapshot();
+    // journal file next to the vault
+    std::string journalFilename() const;
+    // encrypt one journal record
+    std::vector<char> sealJournalRecord(char op, std::string_view payload, long offset);
+    // append encrypted records to the journal in one write
+    void writeJournal(const std::vector<char> &records);
+    // check journal size against compaction threshold
+    bool journalNeedsCompaction(long pendingBytes) const;
+    // encrypt password and notes of one entry
+    SealedSecrets sealSecrets(const PasswordEntry &entry) const;
+    // keep index fields in memory, encrypt password and notes
+    void storeEntry(const PasswordEntry &entry);
+    // remove an entry from the index, secrets and columns
+    void dropEntry(int id);
+    // full entry from its index and sealed secrets
+    PasswordEntry unseal(const PasswordEntry &index) const;
+
+    // decrypt journal records in order, returns bytes of whole records read
+    long readJournal(const std::function<void(char, std::string_view)> &apply);
+    // apply journal records on top of loaded snapshot
+    void replayJournal();
+    // record a mutation, compacting when the journal gets too big
+    void persist(char op, std::string_view payload);
+    // keep before-image of entry the first time a batch touches it
+    void rememberForBatch(int id);
+
   public:
     // construct
     explicit Vault(const std::string &filename);
@@ -58,21 +168,108 @@ class Vault {
     Vault &operator=(const Vault &) = delete;
 
     // full vault operations
-    void create(const std::string &masterPassword);
-    void open(const std::string &masterPassword);
+    void create(std::string_view masterPassword);
+    void open(std::string_view masterPassword);
     void save();
     void close();
+    // fold journal back into a fresh snapshot
+    void compact();
+    // rewrap data key under new password, only header is rewritten
+    void changeMasterPassword(std::string_view newPassword);
+
+    // cipher for new vaults and the next full write (default GCM)
+    // an open CBC vault is re-encrypted by its next save()
+    void setCipherMode(CipherMode mode) {
+      cipherMode = mode;
+    }
+    // cipher the vault file currently uses
+    CipherMode getCipherMode() const {
+      return fileMode;
+    }
+
+    // worker threads used by open(), 0 picks the core count
+    void setThreads(unsigned count) {
+      threads = count;
+    }
+    unsigned getThreads() const;
+
+    // journaled mode appends each mutation instead of rewriting the vault
+    void setJournaling(bool enabled) {
+      journaling = enabled;
+    }
+    bool isJournaling() const {
+      return journaling;
+    }
+    // size of pending journal in bytes
+    long getJournalSize() const {
+      return journalBytes;
+    }
+    // number of durable writes made so far
+    long getWriteCount() const {
+      return writeCount;
+    }
+
+    // batch mutations, persisted together by commit()
+    void beginBatch();
+    void commit();
+    void rollback();
+    bool isInBatch() const {
+      return inBatch;
+    }
+
+    // batch scoped to a block, rolled back unless committed
+    class Transaction {
+      private:
+        Vault &vault;
+        bool finished;
+
+      public:
+        explicit Transaction(Vault &vault);
+        ~Transaction();
+
+        Transaction(const Transaction &) = delete;
+        Transaction &operator=(const Transaction &) = delete;
+
+        void commit();
+        void rollback();
+    };
+
+    // read one entry without opening the whole vault
+    // decrypts the offset table and one record, then applies the journal
+    // vault stays closed, falls back to a full open for files without a table
+    PasswordEntry lookup(std::string_view masterPassword, int id);
+
+    // visitor over stored entries, each index view is valid only during its call
+    using EntryVisitor = std::function<void(const PasswordEntry &)>;
 
     // entry operations
     int addEntry(const PasswordEntry &entry);
     PasswordEntry getEntry(int id) const;
     std::vector<PasswordEntry> getAllEntries() const;
+    // every entry without password and notes, nothing is decrypted
+    std::vector<PasswordEntry> listEntries() const;
+    // visit each index only entry in id order, references stay valid until the vault changes
+    void forEachEntry(const EntryVisitor &visit) const;
+    // same, ordered by service (ties by id)
+    void forEachByService(const EntryVisitor &visit) const;
     void updateEntry(const PasswordEntry &entry);
     void deleteEntry(int id);
 
-    // search entries for specific entry to return
-    std::vector<PasswordEntry> searchByService(const std::string &query) const;
-    std::vector<PasswordEntry> searchByCategory(const std::string &category) const;
+    // entries matching a filter expression (see query.hpp), in id order
+    // a plain word matches service, username, url or category, ignoring case
+    // results are index only like listEntries(), use getEntry() for secrets
+    // throws QueryException on a malformed expression
+    std::vector<PasswordEntry> search(const std::string &expression) const;
+    // same matches as search(), visited in place
+    void forEachMatch(const std::string &expression, const EntryVisitor &visit) const;
+    // entries last changed before cutoff, least recently changed first
+    // a range lookup in the modified time index, no scan
+    void forEachModifiedBefore(time_t cutoff, const EntryVisitor &visit) const;
+    // top limit entries whose service or url is within a few typos of query, best first
+    // exact, prefix and word start matches rank above the rest
+    std::vector<PasswordEntry> fuzzySearch(const std::string &query, size_t limit) const;
+    // entries per category name, "" for uncategorized
+    std::map<std::string, int> countByCategory() const;
 
     // check if vault unlocked
     bool isVaultOpen() const { 
@@ -80,12 +277,16 @@ class Vault {
     }
     // get total num entries 
     int getEntryCount() const { 
-      return entries.size();
+      return columns.size();
     }
     // get name of file
     std::string getFilename() const { 
       return filename;
     }
+    // get file format version
+    int getVersion() const {
+      return version;
+    }
 };
 
 #endif
@@ -0,0 +1,443 @@
+#include "agent.hpp"
+#include "vault.hpp"
+#include "exceptions.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <filesystem>
+#include <sstream>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+namespace Agent {
+  namespace {
+    // client side timeout so a hung agent never blocks a command
+    const int IO_TIMEOUT_SECONDS = 2;
+    const size_t MAX_REQUEST = 4096;
+
+    // size and mtime of vault and journal, agent exits when they change
+    struct FileStamp {
+      long long size = -1;
+      long long mtime = -1;
+
+      bool operator==(const FileStamp &other) const {
+        return size == other.size && mtime == other.mtime;
+      }
+    };
+
+    FileStamp stampOf(const std::string &path) {
+      FileStamp stamp;
+      struct stat info;
+      if (stat(path.c_str(), &info) == 0) {
+        stamp.size = info.st_size;
+        stamp.mtime = static_cast<long long>(info.st_mtime) * 1000000000LL;
+#ifdef __linux__
+        stamp.mtime += info.st_mtim.tv_nsec;
+#endif
+      }
+      return stamp;
+    }
+
+    // stable hash of vault path for socket name (FNV-1a)
+    std::string pathHash(const std::string &path) {
+      uint64_t hash = 1469598103934665603ULL;
+      for (unsigned char c : path) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+      }
+      std::ostringstream oss;
+      oss << std::hex << hash;
+      return oss.str();
+    }
+
+    // directory must be ours and closed to everyone else
+    bool isPrivateDir(const std::string &dir) {
+      struct stat info;
+      if (lstat(dir.c_str(), &info) != 0) {
+        return false;
+      }
+      return S_ISDIR(info.st_mode) && info.st_uid == geteuid() && (info.st_mode & 077) == 0;
+    }
+
+    // only the vault owner may talk to the agent
+    bool peerIsOwner(int fd) {
+#ifdef __linux__
+      ucred cred;
+      socklen_t length = sizeof(cred);
+      if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) != 0) {
+        return false;
+      }
+      return cred.uid == geteuid();
+#else
+      uid_t uid;
+      gid_t gid;
+      if (getpeereid(fd, &uid, &gid) != 0) {
+        return false;
+      }
+      return uid == geteuid();
+#endif
+    }
+
+    bool fillAddress(const std::string &path, sockaddr_un &address) {
+      std::memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+      }
+      std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+      return true;
+    }
+
+    // connect to agent socket, -1 if none
+    int connectTo(const std::string &path) {
+      sockaddr_un address;
+      if (!isPrivateDir(std::filesystem::path(path).parent_path().string()) || !fillAddress(path, address)) {
+        return -1;
+      }
+
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd < 0) {
+        return -1;
+      }
+
+      timeval timeout = {IO_TIMEOUT_SECONDS, 0};
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+      if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+      }
+      return fd;
+    }
+
+    bool sendAll(int fd, std::string_view data) {
+      size_t sent = 0;
+      while (sent < data.size()) {
+        ssize_t n = write(fd, data.data() + sent, data.size() - sent);
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          return false;
+        }
+        sent += n;
+      }
+      return true;
+    }
+
+    // read until newline (server) or eof (client)
+    // replies to get carry a password, so this reads into locked memory
+    SecureString readFrom(int fd, bool untilNewline, size_t limit) {
+      SecureString data;
+      char buffer[4096];
+      while (data.size() < limit) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          break;
+        }
+        data.append(buffer, n);
+        if (untilNewline && data.find('\n') != std::string::npos) {
+          break;
+        }
+      }
+      return data;
+    }
+
+    // reply: "OK <n>\n" then n times "<length>\n<serialized entry>"
+    // list and search send index only entries, get sends the full entry
+    SecureString encode(const std::vector<PasswordEntry> &entries) {
+      SecureString reply = "OK " + SecureString(std::to_string(entries.size())) + "\n";
+      for (const PasswordEntry &entry : entries) {
+        SecureString serialized = entry.hasSecrets() ? entry.serialize() : SecureString(entry.serializeIndex());
+        reply.append(std::to_string(serialized.size()));
+        reply.append("\n");
+        reply.append(serialized);
+      }
+      return reply;
+    }
+
+    // answer one request, false when the agent should exit
+    bool answer(Vault &vault, const std::string &line, int client, const FileStamp &vaultStamp, const FileStamp &journalStamp) {
+      // someone changed the vault, our copy is stale
+      if (!(stampOf(vault.getFilename()) == vaultStamp) || !(stampOf(vault.getFilename() + ".journal") == journalStamp)) {
+        sendAll(client, "ERR stale\n");
+        return false;
+      }
+
+      std::string command = line.substr(0, line.find(' '));
+      std::string argument = line.find(' ') == std::string::npos ? "" : line.substr(line.find(' ') + 1);
+
+      try {
+        // views handed to the visitor live only for the call, keep copies
+        std::vector<PasswordEntry> found;
+        auto collect = [&found](const PasswordEntry &entry) {
+          found.push_back(entry);
+        };
+        if (command == "list") {
+          vault.forEachByService(collect);
+          sendAll(client, encode(found));
+        }
+        else if (command == "get") {
+          found.push_back(vault.getEntry(std::stoi(argument)));
+          sendAll(client, encode(found));
+        }
+        else if (command == "search") {
+          vault.forEachMatch(argument, collect);
+          sendAll(client, encode(found));
+        }
+        else if (command == "find") {
+          // "find <count> <query>"
+          size_t space = argument.find(' ');
+          if (space == std::string::npos) {
+            throw EntryException("Invalid find request");
+          }
+          sendAll(client, encode(vault.fuzzySearch(argument.substr(space + 1), std::stoul(argument.substr(0, space)))));
+        }
+        else if (command == "stop") {
+          sendAll(client, "OK 0\n");
+          return false;
+        }
+        else {
+          sendAll(client, "ERR Unknown agent request: " + command + "\n");
+        }
+      }
+      catch (const std::exception &e) {
+        sendAll(client, std::string("ERR ") + e.what() + "\n");
+      }
+      return true;
+    }
+
+    // accept loop, runs in the detached child
+    void serve(Vault &vault, int server, int ttlSeconds) {
+      FileStamp vaultStamp = stampOf(vault.getFilename());
+      FileStamp journalStamp = stampOf(vault.getFilename() + ".journal");
+
+      while (true) {
+        pollfd pending = {server, POLLIN, 0};
+        int ready = poll(&pending, 1, ttlSeconds * 1000);
+        if (ready < 0 && errno == EINTR) {
+          continue;
+        }
+        // idle ttl reached or socket broke
+        if (ready <= 0) {
+          return;
+        }
+
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0) {
+          continue;
+        }
+        if (!peerIsOwner(client)) {
+          close(client);
+          continue;
+        }
+
+        timeval timeout = {IO_TIMEOUT_SECONDS, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::string line(readFrom(client, true, MAX_REQUEST));
+        line = line.substr(0, line.find('\n'));
+        bool keepGoing = answer(vault, line, client, vaultStamp, journalStamp);
+        close(client);
+
+        if (!keepGoing) {
+          return;
+        }
+      }
+    }
+  }
+
+  // socket path
+  // $XDG_RUNTIME_DIR/openvault or /tmp/openvault-<uid>, one socket per vault
+  std::string socketPath(const std::string &vaultFile) {
+    std::string dir;
+    const char *runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime != nullptr && *runtime != '\0') {
+      dir = std::string(runtime) + "/openvault";
+    }
+    else {
+      dir = "/tmp/openvault-" + std::to_string(geteuid());
+    }
+
+    std::string path = std::filesystem::weakly_canonical(std::filesystem::absolute(vaultFile)).string();
+    return dir + "/agent-" + pathHash(path) + ".sock";
+  }
+
+  // start agent
+  bool start(Vault &vault, int ttlSeconds) {
+    if (!vault.isVaultOpen()) {
+      throw CustomException("Vault is not open");
+    }
+
+    std::string path = socketPath(vault.getFilename());
+    std::string dir = std::filesystem::path(path).parent_path().string();
+    mkdir(dir.c_str(), 0700);
+    if (!isPrivateDir(dir)) {
+      throw FileException("Agent socket directory is not private: " + dir);
+    }
+
+    // one agent per vault
+    int existing = connectTo(path);
+    if (existing >= 0) {
+      close(existing);
+      throw CustomException("Agent already running for " + vault.getFilename());
+    }
+    unlink(path.c_str());
+
+    sockaddr_un address;
+    if (!fillAddress(path, address)) {
+      throw FileException("Agent socket path too long: " + path);
+    }
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+      throw FileException("Cannot create agent socket");
+    }
+    mode_t oldMask = umask(077);
+    int bound = bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    umask(oldMask);
+    if (bound != 0 || chmod(path.c_str(), 0600) != 0 || listen(server, 16) != 0) {
+      close(server);
+      unlink(path.c_str());
+      throw FileException("Cannot listen on agent socket: " + path);
+    }
+
+    // child reports back once its memory is locked
+    int status[2];
+    if (pipe(status) != 0) {
+      close(server);
+      unlink(path.c_str());
+      throw CustomException("Cannot start agent");
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      close(server);
+      close(status[0]);
+      close(status[1]);
+      unlink(path.c_str());
+      throw CustomException("Cannot start agent");
+    }
+
+    if (pid == 0) {
+      close(status[0]);
+      setsid();
+      std::signal(SIGPIPE, SIG_IGN);
+
+      // keep key and entries out of swap and core dumps
+      char locked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0 ? 'L' : 'U';
+#ifdef __linux__
+      prctl(PR_SET_DUMPABLE, 0);
+#endif
+      ssize_t ignored = write(status[1], &locked, 1);
+      (void)ignored;
+      close(status[1]);
+
+      int null = ::open("/dev/null", O_RDWR);
+      if (null >= 0) {
+        dup2(null, STDIN_FILENO);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        close(null);
+      }
+
+      serve(vault, server, ttlSeconds);
+
+      close(server);
+      unlink(path.c_str());
+      // idle, stopped or vault changed: wipe the key and any key schedule cached for it
+      vault.close();
+      CryptoManager::releaseCachedKeys();
+      _exit(0);
+    }
+
+    close(server);
+    close(status[1]);
+    char locked = 0;
+    ssize_t got = read(status[0], &locked, 1);
+    close(status[0]);
+    if (got != 1) {
+      throw CustomException("Agent failed to start");
+    }
+    return locked == 'L';
+  }
+
+  // send request to agent
+  bool request(const std::string &vaultFile, const std::string &command, std::vector<PasswordEntry> &result) {
+    int fd = connectTo(socketPath(vaultFile));
+    if (fd < 0) {
+      return false;
+    }
+
+    if (!sendAll(fd, command + "\n")) {
+      close(fd);
+      return false;
+    }
+    SecureString reply = readFrom(fd, false, static_cast<size_t>(-1));
+    close(fd);
+
+    size_t lineEnd = reply.find('\n');
+    if (lineEnd == std::string::npos) {
+      return false;
+    }
+    std::string status(std::string_view(reply).substr(0, lineEnd));
+    if (status.rfind("ERR ", 0) == 0) {
+      // stale agent is shutting down, caller falls back to the vault file
+      if (status == "ERR stale") {
+        return false;
+      }
+      throw CustomException(status.substr(4));
+    }
+    if (status.rfind("OK ", 0) != 0) {
+      return false;
+    }
+
+    bool full = command.rfind("get ", 0) == 0;
+    try {
+      size_t count = std::stoul(status.substr(3));
+      size_t position = lineEnd + 1;
+      result.clear();
+      for (size_t i = 0; i < count; ++i) {
+        size_t sizeEnd = reply.find('\n', position);
+        if (sizeEnd == std::string::npos) {
+          return false;
+        }
+        size_t size = std::stoul(std::string(std::string_view(reply).substr(position, sizeEnd - position)));
+        if (sizeEnd + 1 + size > reply.size()) {
+          return false;
+        }
+        std::string_view serialized = std::string_view(reply).substr(sizeEnd + 1, size);
+        result.push_back(full ? PasswordEntry::deserialize(serialized) : PasswordEntry::deserializeIndex(serialized));
+        position = sizeEnd + 1 + size;
+      }
+    }
+    catch (const std::exception &e) {
+      return false;
+    }
+    return true;
+  }
+
+  // stop agent
+  bool stop(const std::string &vaultFile) {
+    std::vector<PasswordEntry> none;
+    try {
+      return request(vaultFile, "stop", none);
+    }
+    catch (const CustomException &e) {
+      return false;
+    }
+  }
+}
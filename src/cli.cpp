@@ -7,6 +7,7 @@
 #include <termios.h>
 #include <unistd.h>
 #include <algorithm>
+#include <string_view>
 
 namespace CLI {
   // print usage commands and info to cli
@@ -19,11 +20,21 @@ namespace CLI {
     std::cout << "  change-password       Change master password\n";
     std::cout << "  list-passwords        List all passwords\n";
     std::cout << "  get <id>              Show password details\n";
-    std::cout << "  search <query>        Search passwords\n";
+    std::cout << "  search <filter>       Search passwords (words, field:value, field~text, strength<60, modified<90d)\n";
+    std::cout << "  find <query> [count]  Best matches on service/url, typos allowed\n";
+    std::cout << "  stale [--older-than <age>]\n";
+    std::cout << "                        Entries unchanged for age, oldest first (default 180d)\n";
     std::cout << "  edit <id>             Edit password entry\n";
     std::cout << "  delete <id>           Delete password entry\n";
     std::cout << "  generate [length]     Generate secure password\n";
+    std::cout << "    --count N           Print N passwords, one per line\n";
+    std::cout << "    --threads T         Workers for --count (default: one per core)\n";
     std::cout << "  info                  Show vault statistics\n";
+    std::cout << "  compact               Fold journal into vault file\n";
+    std::cout << "  agent [ttl]           Keep vault unlocked for get/search/find/list\n";
+    std::cout << "  agent-stop            Stop agent and wipe its key\n";
+    std::cout << "  shell                 Run commands against one open vault\n";
+    std::cout << "  batch < script        Run script of commands, save once at end\n";
     std::cout << "\nOptions:\n";
     std::cout << "  --help                Show this help\n";
     std::cout << "  --version             Show version\n";
@@ -31,6 +42,7 @@ namespace CLI {
     std::cout << "  openvault my.ovault create\n";
     std::cout << "  openvault my.ovault add-password\n";
     std::cout << "  openvault my.ovault search github\n";
+    std::cout << "  openvault my.ovault search \"category:work modified<90d strength<60\"\n";
   }
 
   // print version to cli
@@ -40,6 +52,29 @@ namespace CLI {
     std::cout << "Support for documents coming soon!\n";
   }
 
+  // print commands available inside shell/batch
+  void showSessionHelp() {
+    std::cout << "Session commands:\n";
+    std::cout << "  add-password          Add password entry\n";
+    std::cout << "  list-passwords        List all passwords\n";
+    std::cout << "  get <id>              Show password details\n";
+    std::cout << "  search <filter>       Search passwords (words, field:value, field~text, strength<60, modified<90d)\n";
+    std::cout << "  find <query> [count]  Best matches on service/url, typos allowed\n";
+    std::cout << "  stale [--older-than <age>]\n";
+    std::cout << "                        Entries unchanged for age, oldest first (default 180d)\n";
+    std::cout << "  edit <id>             Edit password entry\n";
+    std::cout << "  delete <id>           Delete password entry\n";
+    std::cout << "  generate [length]     Generate secure password\n";
+    std::cout << "    --count N           Print N passwords, one per line\n";
+    std::cout << "    --threads T         Workers for --count (default: one per core)\n";
+    std::cout << "  info                  Show vault statistics\n";
+    std::cout << "  export <file.csv>     Export passwords to CSV\n";
+    std::cout << "  save                  Write pending changes now\n";
+    std::cout << "  compact               Save and fold journal into vault file\n";
+    std::cout << "  rollback              Discard changes since last save\n";
+    std::cout << "  exit                  Save and quit\n";
+  }
+
   // print help info to cli
   void showHelp(const std::string &command) {
     if (command.empty()) {
@@ -68,7 +103,7 @@ namespace CLI {
   }
 
   // read password from user
-  std::string readPassword(const std::string &prompt) {
+  SecureString readPassword(const std::string &prompt) {
     std::cout << prompt;
     std::cout.flush();
 
@@ -81,7 +116,7 @@ namespace CLI {
     tcsetattr(STDIN_FILENO, TCSANOW, &newSettings);
 
     // store
-    std::string password;
+    SecureString password;
     std::getline(std::cin, password);
 
     // turn on echo
@@ -92,7 +127,7 @@ namespace CLI {
   }
 
   // read line
-  std::string readLine(const std::string &prompt) {
+  std::string readLine(std::string_view prompt) {
     std::cout << prompt;
     std::string input;
     std::getline(std::cin, input);
@@ -106,6 +141,16 @@ namespace CLI {
 
   // print table of all entries in vault
   void displayPasswordTable(const std::vector<::PasswordEntry> &entries) {
+    std::vector<const ::PasswordEntry *> pointers;
+    pointers.reserve(entries.size());
+    for (const auto &entry : entries) {
+      pointers.push_back(&entry);
+    }
+    displayPasswordTable(pointers);
+  }
+
+  // print table without copying entries
+  void displayPasswordTable(const std::vector<const ::PasswordEntry *> &entries) {
     if (entries.empty()) {
       std::cout << "No password entries found.\n";
       return;
@@ -119,13 +164,17 @@ namespace CLI {
     printSeparator('-', 100);
 
     // entries
-    for (const auto &entry : entries) {
-      int strength = PasswordGenerator::calculateStrength(entry.getPassword());
+    for (const ::PasswordEntry *entry : entries) {
+      int strength = (*entry).getStrength();
       std::string strength_description = PasswordGenerator::getStrengthDescription(strength);
 
-      std::cout << std::left << std::setw(5) << entry.getId() << std::setw(20) << entry.getService().substr(0, 19)
-                << std::setw(25) << entry.getUsername().substr(0, 24) << std::setw(16) << entry.getCategory().substr(0, 14)
-                << std::setw(24) << formatDate(entry.getModified()) << std::setw(15) << strength_description << "\n";
+      // truncated views, setw pads them like strings
+      std::string_view service = (*entry).getService();
+      std::string_view username = (*entry).getUsername();
+      std::string_view category = (*entry).getCategory();
+      std::cout << std::left << std::setw(5) << (*entry).getId() << std::setw(20) << service.substr(0, 19)
+                << std::setw(25) << username.substr(0, 24) << std::setw(16) << category.substr(0, 14)
+                << std::setw(24) << formatDate((*entry).getModified()) << std::setw(15) << strength_description << "\n";
     }
     printSeparator('-', 100);
     std::cout << "Total: " << entries.size() << " entries\n\n";
@@ -141,7 +190,7 @@ namespace CLI {
     std::cout << "Username:  " << entry.getUsername() << "\n";
     std::cout << "Password:  " << entry.getPassword() << "\n";
 
-    int strength = PasswordGenerator::calculateStrength(entry.getPassword());
+    int strength = entry.getStrength();
     std::string strength_description = PasswordGenerator::getStrengthDescription(strength);
     std::cout << "Strength:  " << strength << "/100 (" << strength_description << ")\n";
 
@@ -179,6 +228,11 @@ namespace CLI {
     std::cerr << "Error: " << message << "\n";
   }
 
+  // print message with warning title, to stderr like errors
+  void printWarning(const std::string &message) {
+    std::cerr << "Warning: " << message << "\n";
+  }
+
   // print message with Success title
   void printSuccess(const std::string &message) {
     std::cout << "Success: " << message << "\n";
@@ -0,0 +1,43 @@
+#include "crypto_engine.hpp"
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+#include <stdexcept>
+
+// init openssl once, then fetch every algorithm the vault uses
+// fetching up front skips the per call provider lookup of EVP_aes_256_*()
+CryptoEngine::CryptoEngine() : cbc(nullptr), gcm(nullptr), keyWrap(nullptr), sha256(nullptr) {
+  if (OPENSSL_init_crypto(OPENSSL_INIT_LOAD_CRYPTO_STRINGS, nullptr) != 1) {
+    throw std::runtime_error("error initializing openssl");
+  }
+
+  cbc = EVP_CIPHER_fetch(nullptr, "AES-256-CBC", nullptr);
+  gcm = EVP_CIPHER_fetch(nullptr, "AES-256-GCM", nullptr);
+  keyWrap = EVP_CIPHER_fetch(nullptr, "AES-256-WRAP", nullptr);
+  sha256 = EVP_MD_fetch(nullptr, "SHA256", nullptr);
+  if (!cbc || !gcm || !keyWrap || !sha256) {
+    release();
+    throw std::runtime_error("cipher not available");
+  }
+}
+
+// openssl registered its own cleanup before this object existed,
+// so this runs first
+CryptoEngine::~CryptoEngine() {
+  release();
+}
+
+// free whatever was fetched, null is fine
+void CryptoEngine::release() {
+  EVP_CIPHER_free(cbc);
+  EVP_CIPHER_free(gcm);
+  EVP_CIPHER_free(keyWrap);
+  EVP_MD_free(sha256);
+  cbc = gcm = keyWrap = nullptr;
+  sha256 = nullptr;
+}
+
+// engine
+const CryptoEngine &CryptoEngine::instance() {
+  static const CryptoEngine engine;
+  return engine;
+}
@@ -1,22 +1,86 @@
 #include "cryptography.hpp"
+#include "crypto_engine.hpp"
+#include "secure_random.hpp"
 #include <openssl/evp.h>
 #include <openssl/rand.h>
-#include <openssl/err.h>
-#include <cstring>
+#include <atomic>
 #include <stdexcept>
 #include <iostream>
 
-// constructor
-// init openssl
-CryptoManager::CryptoManager() {
-  OpenSSL_add_all_algorithms();
-  ERR_load_crypto_strings();
+namespace {
+  // bumped whenever a key buffer may hold a different key, cached schedules older than it are not reused
+  std::atomic<uint64_t> keyGeneration(0);
+  // AES-256
+  constexpr size_t KEY_BYTES = 32;
+
+  // one context per thread, reset instead of reallocated
+  // keeps the key schedule while key buffer, generation, cipher and direction stay the same
+  // no copy of the key is kept, only where it lives
+  struct CipherContext {
+    EVP_CIPHER_CTX* context;
+    const EVP_CIPHER* cipher;
+    int encrypting;
+    const uint8_t* keyAddress;
+    uint64_t generation;
+
+    CipherContext() : context(EVP_CIPHER_CTX_new()), cipher(nullptr), encrypting(-1), keyAddress(nullptr), generation(0) {
+    }
+
+    // freeing the context cleanses its key schedule
+    ~CipherContext() {
+      EVP_CIPHER_CTX_free(context);
+    }
+
+    // ready context for one record
+    EVP_CIPHER_CTX* prepare(const EVP_CIPHER* wanted, int encrypt, std::span<const uint8_t> keyBytes, const uint8_t* iv) {
+      if (!context || keyBytes.size() != KEY_BYTES) {
+        throw std::runtime_error("error initializing");
+      }
+
+      uint64_t current = keyGeneration.load(std::memory_order_acquire);
+      bool sameKey = (cipher == wanted && encrypting == encrypt && keyAddress == keyBytes.data() && generation == current);
+      if (sameKey) {
+        // new iv only
+        if (EVP_CipherInit_ex2(context, nullptr, nullptr, iv, encrypt, nullptr) == 1) {
+          return context;
+        }
+      }
+
+      EVP_CIPHER_CTX_reset(context);
+      cipher = nullptr;
+      if (EVP_CipherInit_ex2(context, wanted, keyBytes.data(), iv, encrypt, nullptr) != 1) {
+        throw std::runtime_error("error initializing");
+      }
+      cipher = wanted;
+      encrypting = encrypt;
+      keyAddress = keyBytes.data();
+      generation = current;
+      return context;
+    }
+
+    // after a failed record, or once the key is gone, start over with a clean context
+    // reset cleanses the key schedule
+    void forget() {
+      cipher = nullptr;
+      encrypting = -1;
+      keyAddress = nullptr;
+      EVP_CIPHER_CTX_reset(context);
+    }
+  };
+
+  thread_local CipherContext threadContext;
+}
+
+// keys changed or wiped: no thread may reuse a cached schedule, this thread drops its own now
+// worker threads free theirs when they exit
+void CryptoManager::releaseCachedKeys() {
+  keyGeneration.fetch_add(1, std::memory_order_release);
+  threadContext.forget();
 }
 
-// destructor
-CryptoManager::~CryptoManager() {
-  EVP_cleanup();
-  ERR_free_strings();
+// constructor
+// openssl is set up once by the engine and never torn down per instance
+CryptoManager::CryptoManager() : engine(&CryptoEngine::instance()) {
 }
 
 // gen random salt value
@@ -24,9 +88,7 @@ std::vector<uint8_t> CryptoManager::generateSalt() {
   std::vector<uint8_t> salt(SALT_SIZE);
   
   // fill with random bytes
-  if (RAND_bytes(salt.data(), SALT_SIZE) != 1) {
-    throw std::runtime_error("generateSalt() failed, error");
-  }
+  SecureRandom::fill(salt);
   
   return salt;
 }
@@ -34,93 +96,225 @@ std::vector<uint8_t> CryptoManager::generateSalt() {
 // gen random IV value
 std::vector<uint8_t> CryptoManager::generateIV() {
   std::vector<uint8_t> iv(IV_SIZE);
+  generateIV(iv);
+  return iv;
+}
+
+// gen random IV into caller buffer
+void CryptoManager::generateIV(std::span<uint8_t> iv) {
+  if (iv.size() != IV_SIZE) {
+    throw std::runtime_error("invalid iv size");
+  }
+
+  // fill with random bytes, from the thread's buffer
+  SecureRandom::fill(iv);
+}
+
+// gen random data encryption key
+SecureBytes CryptoManager::generateKey() {
+  SecureBytes key(KEY_SIZE);
 
   // fill with random bytes
-  if (RAND_bytes(iv.data(), IV_SIZE) != 1) {
-    throw std::runtime_error("generateIV() failed, error");
+  if (RAND_bytes(key.data(), KEY_SIZE) != 1) {
+    throw std::runtime_error("generateKey() failed, error");
   }
-  
-  return iv;
+
+  return key;
+}
+
+// wrap key with AES-256 key wrap (RFC 3394)
+// no iv needed, default iv doubles as integrity check
+std::vector<uint8_t> CryptoManager::wrapKey(std::span<const uint8_t> key, std::span<const uint8_t> kek) {
+  EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
+  EVP_CIPHER_CTX_set_flags(context, EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
+  if (EVP_EncryptInit_ex2(context, engine->wrapCipher(), kek.data(), nullptr, nullptr) != 1) {
+    EVP_CIPHER_CTX_free(context);
+    throw std::runtime_error("error initializing key wrap");
+  }
+
+  std::vector<uint8_t> wrapped(key.size() + 8);
+  int length = 0;
+  if (EVP_EncryptUpdate(context, wrapped.data(), &length, key.data(), key.size()) != 1) {
+    EVP_CIPHER_CTX_free(context);
+    throw std::runtime_error("error wrapping key");
+  }
+
+  EVP_CIPHER_CTX_free(context);
+  wrapped.resize(length);
+  return wrapped;
+}
+
+// unwrap key
+SecureBytes CryptoManager::unwrapKey(const std::vector<uint8_t>& wrapped, std::span<const uint8_t> kek) {
+  EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
+  EVP_CIPHER_CTX_set_flags(context, EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
+  if (EVP_DecryptInit_ex2(context, engine->wrapCipher(), kek.data(), nullptr, nullptr) != 1) {
+    EVP_CIPHER_CTX_free(context);
+    throw std::runtime_error("error initializing key unwrap");
+  }
+
+  SecureBytes key(wrapped.size());
+  int length = 0;
+  if (EVP_DecryptUpdate(context, key.data(), &length, wrapped.data(), wrapped.size()) != 1 || length <= 0) {
+    EVP_CIPHER_CTX_free(context);
+    wipe(key.data(), key.size());
+    throw std::runtime_error("error unwrapping key");
+  }
+
+  EVP_CIPHER_CTX_free(context);
+  key.resize(length);
+  return key;
 }
 
 // derive encryption key from password
 // use PBKDF2
-std::vector<uint8_t> CryptoManager::deriveKey(const std::string& password, const std::vector<uint8_t>& salt) {
-  std::vector<uint8_t> key(KEY_SIZE);
+SecureBytes CryptoManager::deriveKey(std::string_view password, const std::vector<uint8_t>& salt) {
+  SecureBytes key(KEY_SIZE);
   
   // get priv key from password, PBKDF2
-  if (PKCS5_PBKDF2_HMAC(password.c_str(), password.length(), salt.data(), salt.size(), ITERATIONS, EVP_sha256(), KEY_SIZE, key.data()) != 1) {
+  if (PKCS5_PBKDF2_HMAC(password.data(), password.length(), salt.data(), salt.size(), ITERATIONS, engine->digest(), KEY_SIZE, key.data()) != 1) {
     throw std::runtime_error("deriveKey() failed, error");
   }
   
   return key;
 }
 
-// encrypt with AES-256-CBC
-std::vector<uint8_t> CryptoManager::encrypt(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
-  // new context, init encrypt using priv key and iv
-  EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
-  if (EVP_EncryptInit_ex(context, EVP_aes_256_cbc(), nullptr, key.data(), iv.data()) != 1) {
-    EVP_CIPHER_CTX_free(context);
-    throw std::runtime_error("error initializing");
+// ciphertext size for a plaintext size
+size_t CryptoManager::encryptedSize(size_t plaintextSize, CipherMode mode) {
+  if (mode == CipherMode::GCM) {
+    return plaintextSize + GCM_TAG_SIZE;
   }
-  
-  // buffer for encrypted text 
-  std::vector<uint8_t> encryptedtext(plaintext.size() + EVP_CIPHER_block_size(EVP_aes_256_cbc()));
+  // cbc always adds 1..16 bytes of padding
+  return (plaintextSize / BLOCK_SIZE + 1) * BLOCK_SIZE;
+}
+
+// room decrypt() needs for a ciphertext size
+size_t CryptoManager::maxDecryptedSize(size_t encryptedSize, CipherMode mode) {
+  if (mode == CipherMode::GCM) {
+    return encryptedSize > static_cast<size_t>(GCM_TAG_SIZE) ? encryptedSize - GCM_TAG_SIZE : 0;
+  }
+  return encryptedSize + BLOCK_SIZE;
+}
+
+// encrypt with AES-256-CBC or AES-256-GCM
+std::vector<uint8_t> CryptoManager::encrypt(std::span<const uint8_t> plaintext, std::span<const uint8_t> key, const std::vector<uint8_t>& iv,
+                                            CipherMode mode, std::span<const uint8_t> aad) {
+  std::vector<uint8_t> encryptedtext(encryptedSize(plaintext.size(), mode));
+  encryptedtext.resize(encrypt(plaintext, key, iv, encryptedtext, mode, aad));
+  return encryptedtext;
+}
+
+// encrypt into caller buffer, no allocation
+// openssl picks AES-NI / PCLMUL code paths when the cpu has them
+size_t CryptoManager::encrypt(std::span<const uint8_t> plaintext, std::span<const uint8_t> key, std::span<const uint8_t> iv,
+                              std::span<uint8_t> out, CipherMode mode, std::span<const uint8_t> aad) {
+  if (iv.size() != IV_SIZE) {
+    throw std::runtime_error("invalid iv size");
+  }
+  if (out.size() < encryptedSize(plaintext.size(), mode)) {
+    throw std::runtime_error("output buffer too small");
+  }
+  bool gcm = (mode == CipherMode::GCM);
+
+  // gcm reads the first 12 bytes of iv (its default nonce length)
+  EVP_CIPHER_CTX* context = threadContext.prepare(engine->cipher(mode), 1, key, iv.data());
+
+  // associated data is authenticated, not encrypted
   int length = 0;
-  int ciphertext_length = 0;
+  if (gcm && !aad.empty() && EVP_EncryptUpdate(context, nullptr, &length, aad.data(), aad.size()) != 1) {
+    threadContext.forget();
+    throw std::runtime_error("error adding associated data");
+  }
   
   // encrypt plaintext
-  if (EVP_EncryptUpdate(context, encryptedtext.data(), &length, plaintext.data(), plaintext.size()) != 1) {
-    EVP_CIPHER_CTX_free(context);
+  int ciphertext_length = 0;
+  if (EVP_EncryptUpdate(context, out.data(), &length, plaintext.data(), plaintext.size()) != 1) {
+    threadContext.forget();
     throw std::runtime_error("error ecnrypting");
   }
 
   ciphertext_length = length;
-  if (EVP_EncryptFinal_ex(context, encryptedtext.data() + length, &length) != 1) {
-    EVP_CIPHER_CTX_free(context);
+  if (EVP_EncryptFinal_ex(context, out.data() + length, &length) != 1) {
+    threadContext.forget();
     throw std::runtime_error("error adding padding to end of buffer");
   }
   ciphertext_length += length;
-  
-  EVP_CIPHER_CTX_free(context);
-  // remove any unencrypted data in buffer
-  encryptedtext.resize(ciphertext_length);
-  return encryptedtext;
+
+  // tag goes after the ciphertext
+  if (gcm) {
+    if (EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_GET_TAG, GCM_TAG_SIZE, out.data() + ciphertext_length) != 1) {
+      threadContext.forget();
+      throw std::runtime_error("error getting tag");
+    }
+    ciphertext_length += GCM_TAG_SIZE;
+  }
+  return ciphertext_length;
 }
 
 // decrypt
+std::vector<uint8_t> CryptoManager::decrypt(const std::vector<uint8_t>& encryptedtext, std::span<const uint8_t> key, const std::vector<uint8_t>& iv,
+                                            CipherMode mode, std::span<const uint8_t> aad) {
+  return decrypt(std::span<const uint8_t>(encryptedtext), key, std::span<const uint8_t>(iv), mode, aad);
+}
+
+// decrypt from a view
+std::vector<uint8_t> CryptoManager::decrypt(std::span<const uint8_t> encryptedtext, std::span<const uint8_t> key, std::span<const uint8_t> iv,
+                                            CipherMode mode, std::span<const uint8_t> aad) {
+  std::vector<uint8_t> plaintext(maxDecryptedSize(encryptedtext.size(), mode));
+  plaintext.resize(decrypt(encryptedtext, key, iv, plaintext, mode, aad));
+  return plaintext;
+}
+
+// decrypt into caller buffer, no allocation
 // literally same as encrypt() but decrypting
-std::vector<uint8_t> CryptoManager::decrypt(const std::vector<uint8_t>& encryptedtext, const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
-  // new context, init encrypt using priv key and iv
-  EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
-  if (EVP_DecryptInit_ex(context, EVP_aes_256_cbc(), nullptr, key.data(), iv.data()) != 1) {
-    EVP_CIPHER_CTX_free(context);
-    throw std::runtime_error("error initializing");
+size_t CryptoManager::decrypt(std::span<const uint8_t> encryptedtext, std::span<const uint8_t> key, std::span<const uint8_t> iv,
+                              std::span<uint8_t> out, CipherMode mode, std::span<const uint8_t> aad) {
+  if (iv.size() != IV_SIZE) {
+    throw std::runtime_error("invalid iv size");
   }
-  
-  // buffer for plaintext
-  std::vector<uint8_t> plaintext(encryptedtext.size());
+  bool gcm = (mode == CipherMode::GCM);
+  if (gcm && encryptedtext.size() < static_cast<size_t>(GCM_TAG_SIZE)) {
+    throw std::runtime_error("ciphertext shorter than tag");
+  }
+  if (out.size() < maxDecryptedSize(encryptedtext.size(), mode)) {
+    throw std::runtime_error("output buffer too small");
+  }
+  // tag is the last 16 bytes
+  std::span<const uint8_t> body = gcm ? encryptedtext.first(encryptedtext.size() - GCM_TAG_SIZE) : encryptedtext;
+
+  EVP_CIPHER_CTX* context = threadContext.prepare(engine->cipher(mode), 0, key, iv.data());
+
   int length = 0;
-  int plaintext_length = 0;
+  if (gcm && !aad.empty() && EVP_DecryptUpdate(context, nullptr, &length, aad.data(), aad.size()) != 1) {
+    threadContext.forget();
+    throw std::runtime_error("error adding associated data");
+  }
   
   // decrypt encrypted text
-  if (EVP_DecryptUpdate(context, plaintext.data(), &length, encryptedtext.data(), encryptedtext.size()) != 1) {
-    EVP_CIPHER_CTX_free(context);
+  int plaintext_length = 0;
+  if (EVP_DecryptUpdate(context, out.data(), &length, body.data(), body.size()) != 1) {
+    threadContext.forget();
     throw std::runtime_error("error decrypting");
   }
-
   plaintext_length = length;
-  if (EVP_DecryptFinal_ex(context, plaintext.data() + length, &length) != 1) {
-    EVP_CIPHER_CTX_free(context);
-    throw std::runtime_error("error adding padding to end of buffer");
+
+  if (gcm) {
+    // ctrl takes a non const pointer but only reads the tag
+    uint8_t* tag = const_cast<uint8_t*>(encryptedtext.data() + body.size());
+    if (EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_TAG, GCM_TAG_SIZE, tag) != 1) {
+      threadContext.forget();
+      throw std::runtime_error("error setting tag");
+    }
+  }
+
+  // gcm: tag check, cbc: padding check
+  if (EVP_DecryptFinal_ex(context, out.data() + length, &length) != 1) {
+    threadContext.forget();
+    OPENSSL_cleanse(out.data(), plaintext_length);
+    throw std::runtime_error(gcm ? "authentication failed" : "error adding padding to end of buffer");
   }
   plaintext_length += length;
-  
-  EVP_CIPHER_CTX_free(context);
-  // remove any unencrypted data in buffer
-  plaintext.resize(plaintext_length);
-  return plaintext;
+  return plaintext_length;
 }
 
 // wipe
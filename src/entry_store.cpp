@@ -0,0 +1,630 @@
+#include "entry_store.hpp"
+#include "utils.hpp"
+#include "fuzzy_match.hpp"
+#include <algorithm>
+#include <climits>
+#include <optional>
+#include <queue>
+
+namespace {
+  // keep a sorted id list sorted
+  void insertSorted(std::vector<int>& list, int id) {
+    if (list.empty() || list.back() < id) {
+      list.push_back(id);
+      return;
+    }
+    list.insert(std::lower_bound(list.begin(), list.end(), id), id);
+  }
+
+  void eraseSorted(std::vector<int>& list, int id) {
+    auto at = std::lower_bound(list.begin(), list.end(), id);
+    if (at != list.end() && *at == id) {
+      list.erase(at);
+    }
+  }
+
+  void insertTimed(std::vector<std::pair<int64_t, int>>& order, int64_t time, int id) {
+    std::pair<int64_t, int> key(time, id);
+    // an edit stamps the current time, so most insertions land at the end
+    if (order.empty() || order.back() < key) {
+      order.push_back(key);
+      return;
+    }
+    order.insert(std::lower_bound(order.begin(), order.end(), key), key);
+  }
+
+  void eraseTimed(std::vector<std::pair<int64_t, int>>& order, int64_t time, int id) {
+    auto at = std::lower_bound(order.begin(), order.end(), std::pair<int64_t, int>(time, id));
+    if (at != order.end() && at->second == id) {
+      order.erase(at);
+    }
+  }
+
+  // half open [from, to) covering a time clause
+  // INT64_MAX itself is never a stored time, so the bound saturates there instead of wrapping
+  std::pair<int64_t, int64_t> timeBounds(const Query::Clause& clause) {
+    int64_t next = (clause.number == INT64_MAX) ? INT64_MAX : clause.number + 1;
+    switch (clause.op) {
+      case Query::Op::Less:
+        return {INT64_MIN, clause.number};
+      case Query::Op::LessEqual:
+        return {INT64_MIN, next};
+      case Query::Op::Greater:
+        return {next, INT64_MAX};
+      case Query::Op::GreaterEqual:
+        return {clause.number, INT64_MAX};
+      default:
+        return {clause.number, next};
+    }
+  }
+
+  bool isTextField(Query::Field field) {
+    return field == Query::Field::Any || field == Query::Field::Service || field == Query::Field::Username ||
+           field == Query::Field::Url || field == Query::Field::Category;
+  }
+
+  // contains or equals, ascii case ignored
+  bool textMatches(std::string_view value, const Query::Clause& clause) {
+    if (clause.op == Query::Op::Equals && value.size() != clause.text.size()) {
+      return false;
+    }
+    return Utils::containsIgnoreCase(value, clause.text);
+  }
+
+  bool compareNumber(int64_t value, const Query::Clause& clause) {
+    switch (clause.op) {
+      case Query::Op::Less:
+        return value < clause.number;
+      case Query::Op::LessEqual:
+        return value <= clause.number;
+      case Query::Op::Greater:
+        return value > clause.number;
+      case Query::Op::GreaterEqual:
+        return value >= clause.number;
+      default:
+        return value == clause.number;
+    }
+  }
+}
+
+void EntryStore::TextColumn::append(std::string_view value) {
+  offsets.push_back(static_cast<uint32_t>(bytes.size()));
+  lengths.push_back(static_cast<uint32_t>(value.size()));
+  bytes.append(value);
+  live += value.size();
+}
+
+void EntryStore::TextColumn::set(size_t slot, std::string_view value) {
+  // same length or shorter: overwrite in place
+  if (value.size() <= lengths[slot]) {
+    std::copy(value.begin(), value.end(), bytes.begin() + offsets[slot]);
+  }
+  else {
+    offsets[slot] = static_cast<uint32_t>(bytes.size());
+    bytes.append(value);
+  }
+  live = live - lengths[slot] + value.size();
+  lengths[slot] = static_cast<uint32_t>(value.size());
+  pack();
+}
+
+// remove slot, last slot moves into it
+void EntryStore::TextColumn::remove(size_t slot) {
+  live -= lengths[slot];
+  offsets[slot] = offsets.back();
+  lengths[slot] = lengths.back();
+  offsets.pop_back();
+  lengths.pop_back();
+  pack();
+}
+
+void EntryStore::TextColumn::clear() {
+  bytes.clear();
+  bytes.shrink_to_fit();
+  offsets.clear();
+  lengths.clear();
+  live = 0;
+}
+
+// squeeze out bytes no slot points at
+void EntryStore::TextColumn::pack() {
+  // rewrite only once more than half the buffer is dead
+  if (bytes.size() < 4096 || live * 2 >= bytes.size()) {
+    return;
+  }
+  std::string packed;
+  packed.reserve(live);
+  for (size_t slot = 0; slot < offsets.size(); ++slot) {
+    uint32_t offset = static_cast<uint32_t>(packed.size());
+    packed.append(bytes, offsets[slot], lengths[slot]);
+    offsets[slot] = offset;
+  }
+  bytes.swap(packed);
+}
+
+// slot of id, NO_SLOT if not stored
+uint32_t EntryStore::slotOf(int id) const {
+  if (id >= 0 && id < DENSE_ID_LIMIT) {
+    return (static_cast<size_t>(id) < denseSlots.size()) ? denseSlots[id] : NO_SLOT;
+  }
+  auto found = sparseSlots.find(id);
+  return (found != sparseSlots.end()) ? found->second : NO_SLOT;
+}
+
+// point id at slot, NO_SLOT forgets it
+void EntryStore::setSlot(int id, uint32_t slot) {
+  if (id >= 0 && id < DENSE_ID_LIMIT) {
+    if (static_cast<size_t>(id) >= denseSlots.size()) {
+      denseSlots.resize(std::max<size_t>(id + 1, denseSlots.size() * 2), NO_SLOT);
+    }
+    denseSlots[id] = slot;
+  }
+  else if (slot == NO_SLOT) {
+    sparseSlots.erase(id);
+  }
+  else {
+    sparseSlots[id] = slot;
+  }
+}
+
+// id of a category name, new names are added
+uint32_t EntryStore::intern(const std::string& name) {
+  auto found = categoryIds.find(name);
+  if (found != categoryIds.end()) {
+    return found->second;
+  }
+  uint32_t id = static_cast<uint32_t>(categoryNames.size());
+  categoryNames.push_back(name);
+  categoryIds.emplace(name, id);
+  categoryMembers.emplace_back();
+  return id;
+}
+
+std::vector<int> EntryStore::sortedIds(std::vector<uint32_t>& slots) const {
+  std::vector<int> result;
+  result.reserve(slots.size());
+  for (uint32_t slot : slots) {
+    result.push_back(ids[slot]);
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+PasswordEntry EntryStore::entry(int id) const {
+  uint32_t slot = slotOf(id);
+  return PasswordEntry::indexOnly(id, service.at(slot), username.at(slot), url.at(slot), categoryNames[category[slot]],
+                                  created[slot], modified[slot], strength[slot]);
+}
+
+std::vector<int> EntryStore::allIds() const {
+  std::vector<int> result = ids;
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+// trigram index over every stored entry, built on first use
+void EntryStore::buildTrigrams() const {
+  std::lock_guard<std::mutex> guard(buildLock);
+  if (trigramsBuilt) {
+    return;
+  }
+  for (size_t slot = 0; slot < ids.size(); ++slot) {
+    trigrams.add(ids[slot], {service.at(slot), username.at(slot), url.at(slot), categoryNames[category[slot]]});
+  }
+  trigramsBuilt = true;
+}
+
+std::vector<int>::iterator EntryStore::serviceOrderAt(std::string_view name, int id) const {
+  return std::lower_bound(serviceOrder.begin(), serviceOrder.end(), id, [&](int other, int) {
+    std::string_view otherName = service.at(slotOf(other));
+    return otherName < name || (otherName == name && other < id);
+  });
+}
+
+// ids sorted by service, built on first use
+const std::vector<int>& EntryStore::orderedByService() const {
+  if (serviceOrderBuilt) {
+    return serviceOrder;
+  }
+  std::lock_guard<std::mutex> guard(buildLock);
+  if (!serviceOrderBuilt) {
+    serviceOrder = ids;
+    std::sort(serviceOrder.begin(), serviceOrder.end(), [this](int a, int b) {
+      std::string_view nameA = service.at(slotOf(a));
+      std::string_view nameB = service.at(slotOf(b));
+      return nameA < nameB || (nameA == nameB && a < b);
+    });
+    serviceOrderBuilt = true;
+  }
+  return serviceOrder;
+}
+
+// (time, id) pairs sorted by created or modified, built on first use
+const EntryStore::TimeOrder& EntryStore::timeOrder(Query::Field field) const {
+  if (timeOrderBuilt) {
+    return field == Query::Field::Created ? createdOrder : modifiedOrder;
+  }
+  std::lock_guard<std::mutex> guard(buildLock);
+  if (!timeOrderBuilt) {
+    createdOrder.clear();
+    modifiedOrder.clear();
+    for (size_t slot = 0; slot < ids.size(); ++slot) {
+      createdOrder.emplace_back(created[slot], ids[slot]);
+      modifiedOrder.emplace_back(modified[slot], ids[slot]);
+    }
+    std::sort(createdOrder.begin(), createdOrder.end());
+    std::sort(modifiedOrder.begin(), modifiedOrder.end());
+    timeOrderBuilt = true;
+  }
+  return field == Query::Field::Created ? createdOrder : modifiedOrder;
+}
+
+// entries of order with time in [from, to)
+std::pair<EntryStore::TimeOrder::const_iterator, EntryStore::TimeOrder::const_iterator>
+EntryStore::timeRange(const TimeOrder& order, int64_t from, int64_t to) {
+  if (from >= to) {
+    return {order.end(), order.end()};
+  }
+  auto first = std::lower_bound(order.begin(), order.end(), std::pair<int64_t, int>(from, INT_MIN));
+  auto last = std::lower_bound(first, order.end(), std::pair<int64_t, int>(to, INT_MIN));
+  return {first, last};
+}
+
+// ids modified in [from, to), oldest first
+std::vector<int> EntryStore::modifiedBetween(int64_t from, int64_t to) const {
+  auto [first, last] = timeRange(timeOrder(Query::Field::Modified), from, to);
+  std::vector<int> found;
+  found.reserve(last - first);
+  for (auto at = first; at != last; ++at) {
+    found.push_back(at->second);
+  }
+  return found;
+}
+
+void EntryStore::put(const PasswordEntry& entry) {
+  uint32_t slot = slotOf(entry.getId());
+  if (timeOrderBuilt) {
+    if (slot != NO_SLOT && created[slot] != entry.getCreated()) {
+      eraseTimed(createdOrder, created[slot], entry.getId());
+    }
+    if (slot == NO_SLOT || created[slot] != entry.getCreated()) {
+      insertTimed(createdOrder, entry.getCreated(), entry.getId());
+    }
+    if (slot != NO_SLOT && modified[slot] != entry.getModified()) {
+      eraseTimed(modifiedOrder, modified[slot], entry.getId());
+    }
+    if (slot == NO_SLOT || modified[slot] != entry.getModified()) {
+      insertTimed(modifiedOrder, entry.getModified(), entry.getId());
+    }
+  }
+  // a new service moves the id in the service order, taken out here while its old name is still stored
+  bool reorder = serviceOrderBuilt && (slot == NO_SLOT || service.at(slot) != entry.getService());
+  if (reorder && slot != NO_SLOT) {
+    serviceOrder.erase(serviceOrderAt(service.at(slot), entry.getId()));
+  }
+
+  if (trigramsBuilt) {
+    if (slot == NO_SLOT) {
+      trigrams.add(entry.getId(), {entry.getService(), entry.getUsername(), entry.getUrl(), entry.getCategory()});
+    }
+    else {
+      trigrams.update(entry.getId(), {service.at(slot), username.at(slot), url.at(slot), categoryNames[category[slot]]},
+                      {entry.getService(), entry.getUsername(), entry.getUrl(), entry.getCategory()});
+    }
+  }
+
+  if (slot == NO_SLOT) {
+    setSlot(entry.getId(), static_cast<uint32_t>(ids.size()));
+    ids.push_back(entry.getId());
+    service.append(entry.getService());
+    username.append(entry.getUsername());
+    url.append(entry.getUrl());
+    category.push_back(intern(entry.getCategory()));
+    created.push_back(entry.getCreated());
+    modified.push_back(entry.getModified());
+    strength.push_back(entry.getStrength());
+    insertSorted(categoryMembers[category.back()], entry.getId());
+    if (reorder) {
+      serviceOrder.insert(serviceOrderAt(entry.getService(), entry.getId()), entry.getId());
+    }
+    return;
+  }
+
+  service.set(slot, entry.getService());
+  username.set(slot, entry.getUsername());
+  url.set(slot, entry.getUrl());
+  uint32_t categoryId = intern(entry.getCategory());
+  if (categoryId != category[slot]) {
+    eraseSorted(categoryMembers[category[slot]], entry.getId());
+    insertSorted(categoryMembers[categoryId], entry.getId());
+    category[slot] = categoryId;
+  }
+  created[slot] = entry.getCreated();
+  modified[slot] = entry.getModified();
+  strength[slot] = entry.getStrength();
+  if (reorder) {
+    serviceOrder.insert(serviceOrderAt(entry.getService(), entry.getId()), entry.getId());
+  }
+}
+
+void EntryStore::remove(int id) {
+  uint32_t slot = slotOf(id);
+  if (slot == NO_SLOT) {
+    return;
+  }
+  if (trigramsBuilt) {
+    trigrams.remove(id, {service.at(slot), username.at(slot), url.at(slot), categoryNames[category[slot]]});
+  }
+  if (serviceOrderBuilt) {
+    serviceOrder.erase(serviceOrderAt(service.at(slot), id));
+  }
+  if (timeOrderBuilt) {
+    eraseTimed(createdOrder, created[slot], id);
+    eraseTimed(modifiedOrder, modified[slot], id);
+  }
+  eraseSorted(categoryMembers[category[slot]], id);
+
+  // last slot fills the hole
+  uint32_t last = static_cast<uint32_t>(ids.size() - 1);
+  if (slot != last) {
+    ids[slot] = ids[last];
+    setSlot(ids[slot], slot);
+    category[slot] = category[last];
+    created[slot] = created[last];
+    modified[slot] = modified[last];
+    strength[slot] = strength[last];
+  }
+  setSlot(id, NO_SLOT);
+  ids.pop_back();
+  service.remove(slot);
+  username.remove(slot);
+  url.remove(slot);
+  category.pop_back();
+  created.pop_back();
+  modified.pop_back();
+  strength.pop_back();
+}
+
+void EntryStore::clear() {
+  ids.clear();
+  denseSlots.clear();
+  sparseSlots.clear();
+  service.clear();
+  username.clear();
+  url.clear();
+  category.clear();
+  created.clear();
+  modified.clear();
+  strength.clear();
+  categoryNames.clear();
+  categoryIds.clear();
+  categoryMembers.clear();
+  trigrams.clear();
+  trigramsBuilt = false;
+  serviceOrder.clear();
+  serviceOrderBuilt = false;
+  createdOrder.clear();
+  modifiedOrder.clear();
+  timeOrderBuilt = false;
+}
+
+// ids matching every clause of query, ascending
+std::vector<int> EntryStore::select(const Query& query) const {
+  const std::vector<Query::Clause>& clauses = query.clauses();
+
+  // clauses reading the category compiled to one flag per interned name
+  std::vector<std::vector<bool>> categoryFlags(clauses.size());
+  for (size_t i = 0; i < clauses.size(); ++i) {
+    if (clauses[i].field == Query::Field::Any || clauses[i].field == Query::Field::Category) {
+      categoryFlags[i].resize(categoryNames.size());
+      for (size_t name = 0; name < categoryNames.size(); ++name) {
+        categoryFlags[i][name] = textMatches(categoryNames[name], clauses[i]);
+      }
+    }
+  }
+
+  // plan: the shortest id list an index offers, a scan over every slot if none does
+  std::optional<std::vector<int>> candidates;
+  auto offer = [&candidates](std::vector<int> found) {
+    if (!candidates || found.size() < candidates->size()) {
+      candidates = std::move(found);
+    }
+  };
+  for (size_t i = 0; i < clauses.size(); ++i) {
+    const Query::Clause& clause = clauses[i];
+    if (clause.field == Query::Field::Category && clause.op == Query::Op::Equals) {
+      std::vector<int> members;
+      for (size_t name = 0; name < categoryNames.size(); ++name) {
+        if (categoryFlags[i][name]) {
+          members.insert(members.end(), categoryMembers[name].begin(), categoryMembers[name].end());
+        }
+      }
+      std::sort(members.begin(), members.end());
+      offer(std::move(members));
+    }
+    else if (clause.field == Query::Field::Created || clause.field == Query::Field::Modified) {
+      auto [from, to] = timeBounds(clause);
+      auto [first, last] = timeRange(timeOrder(clause.field), from, to);
+      // sorting a wide range back into id order costs more than scanning
+      size_t limit = candidates ? candidates->size() : ids.size() / 4;
+      if (static_cast<size_t>(last - first) < limit) {
+        std::vector<int> inRange;
+        inRange.reserve(last - first);
+        for (auto at = first; at != last; ++at) {
+          inRange.push_back(at->second);
+        }
+        std::sort(inRange.begin(), inRange.end());
+        offer(std::move(inRange));
+      }
+    }
+    else if (isTextField(clause.field) && clause.text.size() >= TrigramIndex::GRAM) {
+      // the trigrams cover every text field, and an equal field contains the text too
+      if (!trigramsBuilt) {
+        buildTrigrams();
+      }
+      offer(*trigrams.candidates(clause.text));
+    }
+  }
+
+  // every clause in one pass per entry, cheap integer tests first
+  std::vector<size_t> order(clauses.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&clauses](size_t a, size_t b) {
+    return static_cast<int>(clauses[a].field) > static_cast<int>(clauses[b].field);
+  });
+  auto accepts = [&](uint32_t slot) {
+    for (size_t i : order) {
+      const Query::Clause& clause = clauses[i];
+      bool holds = false;
+      switch (clause.field) {
+        case Query::Field::Modified:
+          holds = compareNumber(modified[slot], clause);
+          break;
+        case Query::Field::Created:
+          holds = compareNumber(created[slot], clause);
+          break;
+        case Query::Field::Strength:
+          holds = compareNumber(strength[slot], clause);
+          break;
+        case Query::Field::Category:
+          holds = categoryFlags[i][category[slot]];
+          break;
+        case Query::Field::Url:
+          holds = textMatches(url.at(slot), clause);
+          break;
+        case Query::Field::Username:
+          holds = textMatches(username.at(slot), clause);
+          break;
+        case Query::Field::Service:
+          holds = textMatches(service.at(slot), clause);
+          break;
+        case Query::Field::Any:
+          holds = categoryFlags[i][category[slot]] || textMatches(service.at(slot), clause) ||
+                  textMatches(username.at(slot), clause) || textMatches(url.at(slot), clause);
+          break;
+      }
+      if (!holds) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  if (candidates) {
+    std::erase_if(*candidates, [&](int id) {
+      return !accepts(slotOf(id));
+    });
+    return std::move(*candidates);
+  }
+  std::vector<uint32_t> slots;
+  for (size_t slot = 0; slot < ids.size(); ++slot) {
+    if (accepts(static_cast<uint32_t>(slot))) {
+      slots.push_back(static_cast<uint32_t>(slot));
+    }
+  }
+  return sortedIds(slots);
+}
+
+// best fuzzy matches on service or url host, best first
+std::vector<int> EntryStore::matchFuzzy(std::string_view query, size_t limit) const {
+  if (limit == 0) {
+    return {};
+  }
+  FuzzyMatcher matcher(query);
+
+  // the worst kept match is on top, so it is the one pushed out
+  struct Ranked {
+    int score;
+    int distance;
+    int id;
+  };
+  auto better = [](const Ranked& a, const Ranked& b) {
+    return a.score > b.score || (a.score == b.score && a.id < b.id);
+  };
+  std::priority_queue<Ranked, std::vector<Ranked>, decltype(better)> kept(better);
+
+  // a block of slots is filtered, then the services and url hosts left go through
+  // the matcher together, similar lengths side by side keep all of its lanes busy
+  const size_t BLOCK = 64;
+  std::vector<uint32_t> picked;
+  std::vector<std::string_view> texts;
+  std::vector<std::optional<FuzzyMatcher::Match>> found(2 * BLOCK);
+  for (size_t from = 0; from < ids.size(); from += BLOCK) {
+    size_t to = std::min(ids.size(), from + BLOCK);
+    // once full, only matches with no more edits than the worst kept one can get in
+    int reach = (kept.size() < limit) ? matcher.maxErrors() : kept.top().distance;
+
+    picked.clear();
+    texts.resize(2 * BLOCK);
+    for (size_t slot = from; slot < to; ++slot) {
+      std::string_view name = service.at(slot);
+      // host part of the url
+      std::string_view host = url.at(slot);
+      size_t scheme = host.find("://");
+      if (scheme != std::string_view::npos) {
+        host.remove_prefix(scheme + 3);
+      }
+      if (host.starts_with("www.")) {
+        host.remove_prefix(4);
+      }
+      host = host.substr(0, host.find('/'));
+
+      if (matcher.mayMatch(name, reach) || matcher.mayMatch(host, reach)) {
+        texts[picked.size()] = name;
+        texts[BLOCK + picked.size()] = host;
+        picked.push_back(static_cast<uint32_t>(slot));
+      }
+    }
+    if (picked.empty()) {
+      continue;
+    }
+    size_t count = picked.size();
+    // services first, then hosts
+    std::copy(texts.begin() + BLOCK, texts.begin() + BLOCK + count, texts.begin() + count);
+    matcher.match(std::span(texts).first(2 * count), std::span(found).first(2 * count));
+
+    for (size_t i = 0; i < count; ++i) {
+      std::optional<Ranked> best;
+      if (found[i]) {
+        best = Ranked{matcher.rank(texts[i], *found[i]), found[i]->distance, ids[picked[i]]};
+      }
+      // a url match ranks just below the same match in the service
+      if (const auto& link = found[count + i]) {
+        int score = matcher.rank(texts[count + i], *link) - 1;
+        if (!best || score > best->score) {
+          best = Ranked{score, link->distance, ids[picked[i]]};
+        }
+      }
+      if (!best) {
+        continue;
+      }
+
+      if (kept.size() < limit) {
+        kept.push(*best);
+      }
+      else if (better(*best, kept.top())) {
+        kept.pop();
+        kept.push(*best);
+      }
+    }
+  }
+
+  std::vector<int> result(kept.size());
+  for (size_t i = kept.size(); i > 0; --i) {
+    result[i - 1] = kept.top().id;
+    kept.pop();
+  }
+  return result;
+}
+
+std::map<std::string, int> EntryStore::countByCategory() const {
+  std::map<std::string, int> result;
+  for (size_t i = 0; i < categoryNames.size(); ++i) {
+    if (!categoryMembers[i].empty()) {
+      result[categoryNames[i]] = static_cast<int>(categoryMembers[i].size());
+    }
+  }
+  return result;
+}
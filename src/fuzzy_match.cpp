@@ -0,0 +1,115 @@
+#include "fuzzy_match.hpp"
+#include <algorithm>
+#include <cctype>
+#include <bit>
+
+FuzzyMatcher::FuzzyMatcher(std::string_view pattern) : length(std::min(pattern.size(), MAX_PATTERN)) {
+  for (size_t i = 0; i < length; ++i) {
+    unsigned char c = static_cast<unsigned char>(pattern[i]);
+    peq[std::tolower(c)] |= uint64_t(1) << i;
+    peq[std::toupper(c)] |= uint64_t(1) << i;
+  }
+  allowed = (length < 3) ? 0 : static_cast<int>(length / 3);
+}
+
+// vertical deltas all +1: the pattern against an empty text prefix
+FuzzyMatcher::Column FuzzyMatcher::startColumn() const {
+  return Column{~uint64_t(0), 0, static_cast<int>(length), static_cast<int>(length), 0};
+}
+
+// advance over text byte j, eq holds the pattern positions equal to it
+inline __attribute__((always_inline)) void FuzzyMatcher::step(Column& column, uint64_t eq, uint64_t high, size_t j) {
+  uint64_t xv = eq | column.mv;
+  uint64_t xh = (((eq & column.pv) + column.pv) ^ column.pv) | eq;
+  uint64_t ph = column.mv | ~(xh | column.pv);
+  uint64_t mh = column.pv & xh;
+  column.distance += static_cast<int>((ph & high) != 0) - static_cast<int>((mh & high) != 0);
+  // a match may start anywhere, so the top row stays 0 (no carry in)
+  ph <<= 1;
+  mh <<= 1;
+  column.pv = mh | ~(xv | ph);
+  column.mv = ph & xv;
+  if (column.distance < column.best) {
+    column.best = column.distance;
+    column.end = j + 1;
+  }
+}
+
+std::optional<FuzzyMatcher::Match> FuzzyMatcher::finish(std::string_view text, Column& column, size_t from) const {
+  const uint64_t high = uint64_t(1) << (length - 1);
+  for (size_t j = from; j < text.size(); ++j) {
+    step(column, peq[static_cast<unsigned char>(text[j])], high, j);
+  }
+  if (column.best > allowed) {
+    return std::nullopt;
+  }
+  // start is estimated from the pattern length, off by at most the edits
+  return Match{column.best, column.end > length ? column.end - length : 0};
+}
+
+std::optional<FuzzyMatcher::Match> FuzzyMatcher::match(std::string_view text) const {
+  if (length == 0) {
+    return Match{0, 0};
+  }
+  Column column = startColumn();
+  return finish(text, column, 0);
+}
+
+void FuzzyMatcher::match(std::span<const std::string_view> texts, std::span<std::optional<Match>> results) const {
+  size_t i = 0;
+  if (length > 0) {
+    const uint64_t high = uint64_t(1) << (length - 1);
+    // four independent columns per step hide the latency of each one's dependency chain
+    for (; i + LANES <= texts.size(); i += LANES) {
+      const std::string_view* text = texts.data() + i;
+      Column a = startColumn();
+      Column b = startColumn();
+      Column c = startColumn();
+      Column d = startColumn();
+      size_t shared = std::min(std::min(text[0].size(), text[1].size()), std::min(text[2].size(), text[3].size()));
+      for (size_t j = 0; j < shared; ++j) {
+        step(a, peq[static_cast<unsigned char>(text[0][j])], high, j);
+        step(b, peq[static_cast<unsigned char>(text[1][j])], high, j);
+        step(c, peq[static_cast<unsigned char>(text[2][j])], high, j);
+        step(d, peq[static_cast<unsigned char>(text[3][j])], high, j);
+      }
+      // the longer ones finish alone
+      results[i] = finish(text[0], a, shared);
+      results[i + 1] = finish(text[1], b, shared);
+      results[i + 2] = finish(text[2], c, shared);
+      results[i + 3] = finish(text[3], d, shared);
+    }
+  }
+  for (; i < texts.size(); ++i) {
+    results[i] = match(texts[i]);
+  }
+}
+
+int FuzzyMatcher::rank(std::string_view text, const Match& found) const {
+  int rank = 1000 - 100 * found.distance;
+  if (found.start == 0) {
+    rank += 50;
+  }
+  else if (!std::isalnum(static_cast<unsigned char>(text[found.start - 1]))) {
+    rank += 30;
+  }
+  if (found.distance == 0 && text.size() == length) {
+    rank += 20;
+  }
+  return rank - static_cast<int>(std::min<size_t>(text.size(), 80) / 4);
+}
+
+std::optional<int> FuzzyMatcher::score(std::string_view text) const {
+  std::optional<Match> found = match(text);
+  return found ? std::optional<int>(rank(text, *found)) : std::nullopt;
+}
+
+bool FuzzyMatcher::mayMatch(std::string_view text, int maxDistance) const {
+  // pattern positions whose byte occurs somewhere in text
+  uint64_t present = 0;
+  for (char c : text) {
+    present |= peq[static_cast<unsigned char>(c)];
+  }
+  uint64_t all = (length == MAX_PATTERN) ? ~uint64_t(0) : (uint64_t(1) << length) - 1;
+  return std::popcount(all & ~present) <= maxDistance;
+}
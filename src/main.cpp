@@ -3,64 +3,102 @@
 #include <vector>
 #include <algorithm>
 #include <map>
-#include <fstream> 
+#include <fstream>
+#include <cctype>
+#include <cstdlib>
 #include "vault.hpp"
+#include "agent.hpp"
 #include "password_entry.hpp"
 #include "password_generator.hpp"
 #include "cli.hpp"
 #include "exceptions.hpp"
+#include "utils.hpp"
+#include "query.hpp"
+
+// print search results
+template <typename Results>
+void printSearchResults(const std::string& query, const Results& results) {
+  if (results.empty()) {
+    CLI::printInfo("No entries found matching: " + query);
+  } else {
+    CLI::printSuccess("Found " + std::to_string(results.size()) + " matching entries:");
+    CLI::displayPasswordTable(results);
+  }
+}
 
 // handle list password command input
-void handleListPasswords(const std::string& vaultFile) {
-  std::string master_password = CLI::readPassword("Master password: ");
-  
-  Vault vault(vaultFile);
-  vault.open(master_password);
-  
-  auto entries = vault.getAllEntries();
-  
-  // sort
-  std::sort(entries.begin(), entries.end(), [](const PasswordEntry& a, const PasswordEntry& b) {
-    return a.getService() < b.getService();
+// entries come out already sorted by service
+void handleListPasswords(Vault& vault) {
+  std::vector<PasswordEntry> entries;
+  entries.reserve(vault.getEntryCount());
+  vault.forEachByService([&entries](const PasswordEntry& entry) {
+    entries.push_back(entry);
   });
-  
   CLI::displayPasswordTable(entries);
 }
 
-// handle search command input
-void handleSearch(const std::string& vaultFile, const std::string& query) {
-  std::string master_password = CLI::readPassword("Master password: ");
-  
-  Vault vault(vaultFile);
-  vault.open(master_password);
-  
-  auto entries = vault.getAllEntries();
+// search expression from the words after the command
+// a word holding spaces was quoted, quote it again so it stays one term
+std::string joinQuery(const std::vector<std::string>& args) {
+  std::string query;
+  for (size_t i = 1; i < args.size(); ++i) {
+    if (i > 1) {
+      query += ' ';
+    }
+    bool grouped = args[i].find(' ') != std::string::npos && args[i].find('"') == std::string::npos;
+    query += grouped ? "\"" + args[i] + "\"" : args[i];
+  }
+  return query;
+}
+
+// handle search command input, query is a filter expression (see query.hpp)
+void handleSearch(Vault& vault, const std::string& query) {
   std::vector<PasswordEntry> results;
-  
-  // filter
-  std::copy_if(entries.begin(), entries.end(), std::back_inserter(results), [&query](const PasswordEntry& entry) {
-    std::string low_query = query;
-    std::transform(low_query.begin(), low_query.end(), low_query.begin(), ::tolower);
-    
-    std::string service = entry.getService();
-    std::string username = entry.getUsername();
-    std::string category = entry.getCategory();
-    
-    std::transform(service.begin(), service.end(), service.begin(), ::tolower);
-    std::transform(username.begin(), username.end(), username.begin(), ::tolower);
-    std::transform(category.begin(), category.end(), category.begin(), ::tolower);
-    
-    return (service.find(low_query) != (std::string::npos || username.find(low_query) != std::string::npos || category.find(low_query) != std::string::npos));
+  vault.forEachMatch(query, [&results](const PasswordEntry& entry) {
+    results.push_back(entry);
+  });
+  printSearchResults(query, results);
+}
+
+// handle find command input, results stay in rank order
+void handleFind(Vault& vault, const std::string& query, size_t limit) {
+  printSearchResults(query, vault.fuzzySearch(query, limit));
+}
+
+// handle stale command input: entries not changed within the given age, oldest first
+// age like 180d, 26w or 1y
+void handleStale(Vault& vault, const std::string& age) {
+  time_t cutoff = time(nullptr) - Query::ageSeconds(age);
+
+  std::vector<PasswordEntry> results;
+  vault.forEachModifiedBefore(cutoff, [&results](const PasswordEntry& entry) {
+    results.push_back(entry);
   });
-  
   if (results.empty()) {
-    CLI::printInfo("No entries found matching: " + query);
+    CLI::printInfo("Every entry was changed in the last " + age);
   } else {
-    CLI::printSuccess("Found " + std::to_string(results.size()) + " matching entries:");
+    CLI::printInfo(std::to_string(results.size()) + " entries not changed in the last " + age + ", oldest first:");
     CLI::displayPasswordTable(results);
   }
 }
 
+// parse optional result count of find
+size_t parseLimit(const std::vector<std::string>& args) {
+  if (args.size() < 3) {
+    return 10;
+  }
+  int limit = 0;
+  try {
+    limit = std::stoi(args[2]);
+  } catch (const std::exception& e) {
+    limit = 0;
+  }
+  if (limit <= 0) {
+    throw EntryException("Invalid result count: " + args[2]);
+  }
+  return limit;
+}
+
 // handle create vault command input
 void handleCreate(const std::string& vaultFile) {
   std::cout << "Creating new vault: " << vaultFile << "\n";
@@ -69,13 +107,13 @@ void handleCreate(const std::string& vaultFile) {
     return;
   }
   
-  std::string password1 = CLI::readPassword("Enter master password: ");
+  SecureString password1 = CLI::readPassword("Enter master password: ");
   if (password1.empty()) {
     CLI::printError("Master password cannot be empty!");
     return;
   }
 
-  std::string password2 = CLI::readPassword("Confirm master password: ");
+  SecureString password2 = CLI::readPassword("Confirm master password: ");
   
   // check pass reqs
   if (password1 != password2) {
@@ -106,12 +144,7 @@ void handleCreate(const std::string& vaultFile) {
 }
 
 // handle add entry command input
-void handleAddPassword(const std::string& vaultFile) {
-  std::string master_password = CLI::readPassword("Master password: ");
-  
-  Vault vault(vaultFile);
-  vault.open(master_password);
-  
+void handleAddPassword(Vault& vault) {
   // get info
   std::cout << "\n";
   CLI::printSeparator('=', 50);
@@ -121,7 +154,7 @@ void handleAddPassword(const std::string& vaultFile) {
   std::string service = CLI::readLine("Service/Website: ");
   std::string username = CLI::readLine("Username: ");
   
-  std::string password;
+  SecureString password;
   std::string password_choice = CLI::readLine("Password (leave empty to generate): ");
   
   if (password_choice.empty()) {
@@ -161,23 +194,13 @@ void handleAddPassword(const std::string& vaultFile) {
 }
 
 // handle get entry get command input
-void handleGet(const std::string& vaultFile, int id) {
-  std::string master_password = CLI::readPassword("Master password: ");
-  
-  Vault vault(vaultFile);
-  vault.open(master_password);
-  
+void handleGet(Vault& vault, int id) {
   PasswordEntry entry = vault.getEntry(id);
   CLI::displayPasswordDetail(entry);
 }
 
 // hangle entry delete command input
-void handleDelete(const std::string& vaultFile, int id) {
-  std::string master_password = CLI::readPassword("Master password: ");
-  
-  Vault vault(vaultFile);
-  vault.open(master_password);
-  
+void handleDelete(Vault& vault, int id) {
   PasswordEntry entry = vault.getEntry(id);
   
   std::cout << "Delete password entry for: " << entry.getService() << " (" << entry.getUsername() << ")\n";
@@ -194,12 +217,7 @@ void handleDelete(const std::string& vaultFile, int id) {
 }
 
 // handle entry edit command input
-void handleEdit(const std::string& vaultFile, int id) {
-  std::string master_password = CLI::readPassword("Master password: ");
-  
-  Vault vault(vaultFile);
-  vault.open(master_password);
-  
+void handleEdit(Vault& vault, int id) {
   PasswordEntry entry = vault.getEntry(id);
   
   std::cout << "\nEditing entry: " << entry.getService() << "\n";
@@ -207,7 +225,7 @@ void handleEdit(const std::string& vaultFile, int id) {
   
   std::string service = CLI::readLine("Service [" + entry.getService() + "]: ");
   std::string username = CLI::readLine("Username [" + entry.getUsername() + "]: ");
-  std::string password = CLI::readPassword("Password [unchanged]: ");
+  SecureString password = CLI::readPassword("Password [unchanged]: ");
   std::string url = CLI::readLine("URL [" + entry.getUrl() + "]: ");
   std::string category = CLI::readLine("Category [" + entry.getCategory() + "]: ");
   std::string notes = CLI::readLine("Notes [" + entry.getNotes() + "]: ");
@@ -240,7 +258,7 @@ void handleEdit(const std::string& vaultFile, int id) {
 
 // handle password generate command input
 void handleGenerate(int length) {
-  std::string password = PasswordGenerator::generate(length);
+  SecureString password = PasswordGenerator::generate(length);
   int strength = PasswordGenerator::calculateStrength(password);
   
   std::cout << "\nGenerated password: " << password << "\n";
@@ -248,31 +266,83 @@ void handleGenerate(int length) {
   std::cout << "Length: " << password.length() << " characters\n\n";
 }
 
+// positive number argument, 0 if text is not one
+int parsePositive(const std::string& text) {
+  try {
+    size_t used = 0;
+    int value = std::stoi(text, &used);
+    return (used == text.size() && value > 0) ? value : 0;
+  } catch (const std::exception& e) {
+    return 0;
+  }
+}
+
+// OPENVAULT_THREADS if set and valid, capped at a few workers per core
+// 0 (one per core) when unset or invalid
+unsigned threadsFromEnvironment() {
+  const char* text = std::getenv("OPENVAULT_THREADS");
+  if (text == nullptr) {
+    return 0;
+  }
+  int threads = parsePositive(text);
+  if (threads == 0) {
+    CLI::printWarning("Ignoring OPENVAULT_THREADS, expected a positive number: " + std::string(text));
+    return 0;
+  }
+  return std::min<unsigned>(threads, Utils::defaultThreads() * 4);
+}
+
+// handle generate command input: generate [length] [--count N] [--threads T]
+// with --count only the passwords are printed, one per line, for piping into provisioning
+int handleGenerateCommand(const std::vector<std::string>& args) {
+  int length = 16;
+  int count = 0;
+  unsigned threads = Utils::defaultThreads();
+  for (size_t i = 1; i < args.size(); ++i) {
+    const std::string& name = args[i];
+    if (name == "--count" || name == "--threads") {
+      ++i;
+    }
+    int value = (i < args.size()) ? parsePositive(args[i]) : 0;
+    if (value == 0) {
+      CLI::printError("Usage: openvault <vault> generate [length] [--count N] [--threads T]");
+      return 1;
+    }
+    if (name == "--count") {
+      count = value;
+    } else if (name == "--threads") {
+      threads = value;
+    } else {
+      length = value;
+    }
+  }
+
+  if (count == 0) {
+    handleGenerate(length);
+    return 0;
+  }
+  SecureString passwords = PasswordGenerator::generateMany(count, length, threads);
+  std::cout.write(passwords.data(), passwords.size());
+  std::cout.flush();
+  return 0;
+}
+
 // handle vault info command input
-void handleInfo(const std::string& vaultFile) {
-  std::string master_password = CLI::readPassword("Master password: ");
-  
-  Vault vault(vaultFile);
-  vault.open(master_password);
-  
-  auto entries = vault.getAllEntries();
-  
+void handleInfo(Vault& vault) {
   std::cout << "\n";
   CLI::printSeparator('=', 50);
   std::cout << "Vault Information\n";
   CLI::printSeparator('=', 50);
-  std::cout << "File:    " << vaultFile << "\n";
-  std::cout << "Entries: " << entries.size() << "\n";
+  std::cout << "File:    " << vault.getFilename() << "\n";
+  std::cout << "Entries: " << vault.getEntryCount() << "\n";
   
   // count categories
-  std::map<std::string, int> count;
-  std::for_each(entries.begin(), entries.end(), [&count](const PasswordEntry& entry) {
-    std::string category = entry.getCategory();
-    if (category.empty()) {
-      category = "(none)";
-    }
-    count[category]++;
-  });
+  std::map<std::string, int> count = vault.countByCategory();
+  auto uncategorized = count.find("");
+  if (uncategorized != count.end()) {
+    count["(none)"] += uncategorized->second;
+    count.erase(uncategorized);
+  }
   
   if (!count.empty()) {
     std::cout << "\nCategories:\n";
@@ -286,17 +356,12 @@ void handleInfo(const std::string& vaultFile) {
 }
 
 // handle change vault password command input
-void handleChangePassword(const std::string& vaultFile) {
-  std::string old_password = CLI::readPassword("Current master password: ");
-  
-  Vault vault(vaultFile);
-  vault.open(old_password);
-  
+void handleChangePassword(Vault& vault, std::string_view old_password) {
   std::cout << "\n";
   
   // new pass
-  std::string new_password1 = CLI::readPassword("New master password: ");
-  std::string new_password2 = CLI::readPassword("Confirm new password: ");
+  SecureString new_password1 = CLI::readPassword("New master password: ");
+  SecureString new_password2 = CLI::readPassword("Confirm new password: ");
   
   if (new_password1 != new_password2) {
     CLI::printError("Passwords do not match");
@@ -313,50 +378,43 @@ void handleChangePassword(const std::string& vaultFile) {
     return;
   }
   
-  auto entries = vault.getAllEntries();
-  vault.close();
+  // only the header changes, entries stay encrypted under the same data key
+  vault.changeMasterPassword(new_password1);
   
-  // make temp backup
-  std::string backupFile = vaultFile + ".backup";
-  std::ifstream src(vaultFile, std::ios::binary);
-  std::ofstream dst(backupFile, std::ios::binary);
-  dst << src.rdbuf();
-  src.close();
-  dst.close();
-  
-  CLI::printInfo("Created backup: " + backupFile);
+  CLI::printSuccess("Master password changed successfully");
+}
+
+// handle vault compact command input
+void handleCompact(Vault& vault) {
+  long journalSize = vault.getJournalSize();
+  vault.compact();
   
-  try {
-    std::remove(vaultFile.c_str());
-    Vault newVault(vaultFile);
-    newVault.create(new_password1);
-    
-    CLI::printInfo("Re-encrypting " + std::to_string(entries.size()) + " entries...");
-    
-    for (const auto& entry : entries) {
-      newVault.addEntry(entry);
-    }
-    
-    newVault.close();
-    std::remove(backupFile.c_str());
-    
-    CLI::printSuccess("Master password changed successfully");
-    CLI::printInfo("All entries re-encrypted with new password");
-  } catch (...) {
-    std::remove(vaultFile.c_str());
-    std::rename(backupFile.c_str(), vaultFile.c_str());
-    CLI::printError("Failed to change password. Vault restored from backup.");
-    throw;
+  CLI::printSuccess("Vault compacted (" + std::to_string(journalSize) + " journal bytes folded into snapshot)");
+}
+
+// handle agent start command input
+void handleAgent(Vault& vault, int ttl) {
+  bool locked = Agent::start(vault, ttl);
+  
+  CLI::printSuccess("Agent started for " + vault.getFilename());
+  CLI::printInfo("Socket: " + Agent::socketPath(vault.getFilename()));
+  CLI::printInfo("Exits after " + std::to_string(ttl) + "s idle, on agent-stop, or when the vault changes");
+  if (!locked) {
+    std::cout << "WARNING: agent memory could not be locked and may be swapped (check ulimit -l)\n";
+  }
+}
+
+// handle agent stop command input
+void handleAgentStop(const std::string& vaultFile) {
+  if (Agent::stop(vaultFile)) {
+    CLI::printSuccess("Agent stopped");
+  } else {
+    CLI::printInfo("No agent running for " + vaultFile);
   }
 }
 
 // handle vault export command input
-void handleExport(const std::string& vaultFile, const std::string& outputFile) {
-  std::string master_password = CLI::readPassword("Master password: ");
-  
-  Vault vault(vaultFile);
-  vault.open(master_password);
-  
+void handleExport(Vault& vault, const std::string& outputFile) {
   auto entries = vault.getAllEntries();
   
   std::ofstream out(outputFile);
@@ -382,6 +440,239 @@ void handleExport(const std::string& vaultFile, const std::string& outputFile) {
   CLI::printInfo("Delete the file after use or encrypt it separately");
 }
 
+// commands that need the vault open
+bool isVaultCommand(const std::string& command) {
+  static const std::vector<std::string> commands = {
+    "add-password", "list-passwords", "list", "search", "find", "stale", "get", "edit", "delete",
+    "info", "change-password", "compact", "export", "agent", "shell", "batch"
+  };
+  return std::find(commands.begin(), commands.end(), command) != commands.end();
+}
+
+// parse id argument
+int parseId(const std::string& arg) {
+  try {
+    return std::stoi(arg);
+  } catch (const std::exception& e) {
+    throw EntryException("Invalid entry id: " + arg);
+  }
+}
+
+// answer read only commands from a running agent
+// false if no agent could answer, caller opens the vault instead
+bool runWithAgent(const std::string& vaultFile, const std::vector<std::string>& args) {
+  const std::string& command = args[0];
+  std::vector<PasswordEntry> entries;
+  
+  if (command == "list-passwords" || command == "list") {
+    if (!Agent::request(vaultFile, "list", entries)) {
+      return false;
+    }
+    // the agent sends them in service order
+    CLI::displayPasswordTable(entries);
+    return true;
+  }
+  if (command == "search" && args.size() >= 2) {
+    std::string query = joinQuery(args);
+    if (!Agent::request(vaultFile, "search " + query, entries)) {
+      return false;
+    }
+    printSearchResults(query, entries);
+    return true;
+  }
+  if (command == "find" && args.size() >= 2) {
+    if (!Agent::request(vaultFile, "find " + std::to_string(parseLimit(args)) + " " + args[1], entries)) {
+      return false;
+    }
+    printSearchResults(args[1], entries);
+    return true;
+  }
+  if (command == "get" && args.size() >= 2) {
+    if (!Agent::request(vaultFile, "get " + std::to_string(parseId(args[1])), entries) || entries.size() != 1) {
+      return false;
+    }
+    CLI::displayPasswordDetail(entries[0]);
+    return true;
+  }
+  return false;
+}
+
+// run one command against an open vault
+// shared by one shot commands, shell and batch
+int runCommand(Vault& vault, const std::vector<std::string>& args, std::string_view masterPassword) {
+  const std::string& command = args[0];
+  
+  if (command == "add-password") {
+    handleAddPassword(vault);
+  } else if (command == "list-passwords" || command == "list") {
+    handleListPasswords(vault);
+  } else if (command == "search") {
+    if (args.size() < 2) {
+      CLI::printError("Usage: openvault <vault> search <query>");
+      return 1;
+    }
+    handleSearch(vault, joinQuery(args));
+  } else if (command == "find") {
+    if (args.size() < 2) {
+      CLI::printError("Usage: openvault <vault> find <query> [count]");
+      return 1;
+    }
+    handleFind(vault, args[1], parseLimit(args));
+  } else if (command == "stale") {
+    if (args.size() == 2 || (args.size() >= 3 && args[1] != "--older-than")) {
+      CLI::printError("Usage: openvault <vault> stale [--older-than <age>]");
+      return 1;
+    }
+    handleStale(vault, args.size() >= 3 ? args[2] : "180d");
+  } else if (command == "get") {
+    if (args.size() < 2) {
+      CLI::printError("Usage: openvault <vault> get <id>");
+      return 1;
+    }
+    handleGet(vault, parseId(args[1]));
+  } else if (command == "edit") {
+    if (args.size() < 2) {
+      CLI::printError("Usage: openvault <vault> edit <id>");
+      return 1;
+    }
+    handleEdit(vault, parseId(args[1]));
+  } else if (command == "delete") {
+    if (args.size() < 2) {
+      CLI::printError("Usage: openvault <vault> delete <id>");
+      return 1;
+    }
+    handleDelete(vault, parseId(args[1]));
+  } else if (command == "generate") {
+    return handleGenerateCommand(args);
+  } else if (command == "info") {
+    handleInfo(vault);
+  } else if (command == "change-password") {
+    handleChangePassword(vault, masterPassword);
+  } else if (command == "compact") {
+    handleCompact(vault);
+  } else if (command == "export") {
+    if (args.size() < 2) {
+      CLI::printError("Usage: openvault <vault> export <output.csv>");
+      return 1;
+    }
+    handleExport(vault, args[1]);
+  } else {
+    CLI::printError("Unknown command: " + command);
+    CLI::printInfo("Use 'openvault --help' for usage information");
+    return 1;
+  }
+  return 0;
+}
+
+// split command line into words, "double quotes" group words
+std::vector<std::string> splitCommand(const std::string& line) {
+  std::vector<std::string> words;
+  std::string word;
+  bool quoted = false;
+  bool hasWord = false;
+  
+  for (char c : line) {
+    if (c == '"') {
+      quoted = !quoted;
+      hasWord = true;
+    } else if (!quoted && std::isspace(static_cast<unsigned char>(c))) {
+      if (hasWord) {
+        words.push_back(word);
+        word.clear();
+        hasWord = false;
+      }
+    } else {
+      word += c;
+      hasWord = true;
+    }
+  }
+  if (hasWord) {
+    words.push_back(word);
+  }
+  return words;
+}
+
+// handle shell and batch command input
+// one open vault for every command, changes are saved once at exit or on 'save'
+// batch stops at the first failing command and saves nothing
+int handleSession(Vault& vault, std::string_view masterPassword, bool interactive) {
+  vault.beginBatch();
+  
+  if (interactive) {
+    CLI::printInfo("Vault " + vault.getFilename() + " open, " + std::to_string(vault.getEntryCount()) + " entries");
+    CLI::printInfo("Type 'help' for commands, 'exit' to save and quit");
+  }
+  
+  std::string line;
+  while (true) {
+    if (interactive) {
+      std::cout << "openvault> ";
+      std::cout.flush();
+    }
+    if (!std::getline(std::cin, line)) {
+      break;
+    }
+    
+    std::vector<std::string> args = splitCommand(line);
+    if (args.empty() || args[0][0] == '#') {
+      continue;
+    }
+    const std::string& command = args[0];
+    
+    if (command == "exit" || command == "quit") {
+      break;
+    }
+    if (command == "help") {
+      CLI::showSessionHelp();
+      continue;
+    }
+    if (command == "save" || command == "compact") {
+      vault.commit();
+      if (command == "compact") {
+        vault.compact();
+      }
+      vault.beginBatch();
+      CLI::printSuccess("Saved");
+      continue;
+    }
+    if (command == "rollback") {
+      vault.rollback();
+      vault.beginBatch();
+      CLI::printInfo("Unsaved changes discarded");
+      continue;
+    }
+    if (command == "create" || command == "agent" || command == "shell" || command == "batch" ||
+        command == "change-password") {
+      CLI::printError("'" + command + "' is not available inside a session");
+      if (!interactive) {
+        vault.rollback();
+        return 1;
+      }
+      continue;
+    }
+    
+    int status = 0;
+    try {
+      status = runCommand(vault, args, masterPassword);
+    } catch (const CustomException& e) {
+      CLI::printError(e.what());
+      status = 1;
+    } catch (const std::exception& e) {
+      CLI::printError(std::string("Unexpected error: ") + e.what());
+      status = 1;
+    }
+    
+    if (status != 0 && !interactive) {
+      vault.rollback();
+      CLI::printError("Batch stopped at: " + line + " (no changes saved)");
+      return 1;
+    }
+  }
+  
+  vault.commit();
+  return 0;
+}
+
 int main(int argc, char* argv[]) {
   try {
     // flags
@@ -404,59 +695,63 @@ int main(int argc, char* argv[]) {
     }
     
     std::string vault_file = argv[1];
-    std::string command = argv[2];
+    std::vector<std::string> args(argv + 2, argv + argc);
+    std::string command = args[0];
     
-    // check command
+    // commands without an open vault
     if (command == "create") {
       handleCreate(vault_file);
-    } else if (command == "add-password") {
-      handleAddPassword(vault_file);
-    } else if (command == "list-passwords" || command == "list") {
-      handleListPasswords(vault_file);
-    } else if (command == "search") {
-      if (argc < 4) {
-        CLI::printError("Usage: openvault <vault> search <query>");
-        return 1;
-      }
-      handleSearch(vault_file, argv[3]);
-    } else if (command == "get") {
-      if (argc < 4) {
-        CLI::printError("Usage: openvault <vault> get <id>");
-        return 1;
-      }
-      handleGet(vault_file, std::stoi(argv[3]));
-    } else if (command == "edit") {
-      if (argc < 4) {
-        CLI::printError("Usage: openvault <vault> edit <id>");
-        return 1;
-      }
-      handleEdit(vault_file, std::stoi(argv[3]));
-    } else if (command == "delete") {
-      if (argc < 4) {
-        CLI::printError("Usage: openvault <vault> delete <id>");
-        return 1;
-      }
-      handleDelete(vault_file, std::stoi(argv[3]));
-    } else if (command == "generate") {
-      int length = (argc >= 4) ? std::stoi(argv[3]) : 16;
-      handleGenerate(length);
-    } else if (command == "info") {
-      handleInfo(vault_file);
-    } else if (command == "change-password") {
-      handleChangePassword(vault_file);
-    } else if (command == "export") {
-      if (argc < 4) {
-        CLI::printError("Usage: openvault <vault> export <output.csv>");
-        return 1;
-      }
-      handleExport(vault_file, argv[3]);
-    } else {
+      return 0;
+    }
+    if (command == "generate") {
+      return handleGenerateCommand(args);
+    }
+    if (command == "agent-stop") {
+      handleAgentStop(vault_file);
+      return 0;
+    }
+    if (!isVaultCommand(command)) {
       CLI::printError("Unknown command: " + command);
       CLI::printInfo("Use 'openvault --help' for usage information");
       return 1;
     }
+    // idle timeout in seconds, checked before asking for the password
+    int ttl = Agent::DEFAULT_TTL;
+    if (command == "agent" && args.size() >= 2) {
+      ttl = parsePositive(args[1]);
+      if (ttl == 0) {
+        CLI::printError("Usage: openvault <vault> agent [ttl seconds]");
+        return 1;
+      }
+    }
     
-    return 0;
+    // running agent answers without a key derivation
+    if (runWithAgent(vault_file, args)) {
+      return 0;
+    }
+    
+    SecureString master_password = CLI::readPassword(command == "change-password" ? "Current master password: " : "Master password: ");
+    
+    Vault vault(vault_file);
+    // decrypt workers, one per core unless set
+    vault.setThreads(threadsFromEnvironment());
+
+    // one entry only needs the offset table and its own record
+    if (command == "get" && args.size() >= 2) {
+      CLI::displayPasswordDetail(vault.lookup(master_password, parseId(args[1])));
+      return 0;
+    }
+    vault.open(master_password);
+    
+    if (command == "agent") {
+      handleAgent(vault, ttl);
+      return 0;
+    }
+    if (command == "shell" || command == "batch") {
+      return handleSession(vault, master_password, command == "shell");
+    }
+    
+    return runCommand(vault, args, master_password);
   } catch (const InvalidPasswordException& e) {
       CLI::printError(e.what());
       return 1;
@@ -470,4 +765,4 @@ int main(int argc, char* argv[]) {
       CLI::printError(std::string("Unexpected error: ") + e.what());
       return 1;
   }
-}
\ No newline at end of file
+}
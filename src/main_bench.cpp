@@ -0,0 +1,383 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include "vault.hpp"
+#include "password_entry.hpp"
+#include "utils.hpp"
+#include "cryptography.hpp"
+#include "text_match.hpp"
+#include "password_generator.hpp"
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+// benchmarks for the vault internals, not part of the cli
+// usage: main_bench open|save|lookup|cipher|search|match|generate [entries] [max threads]
+
+const std::string BENCH_PASSWORD = "BenchPassword123!";
+
+// milliseconds taken by one call
+double timeMs(const std::function<void()>& work) {
+  auto start = std::chrono::steady_clock::now();
+  work();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// synthetic vault with count entries, written with one snapshot
+void buildVault(const std::string& file, int count) {
+  std::remove(file.c_str());
+  std::remove((file + ".journal").c_str());
+
+  Vault vault(file);
+  vault.create(BENCH_PASSWORD);
+  vault.beginBatch();
+  for (int i = 0; i < count; ++i) {
+    PasswordEntry entry(0, "service" + std::to_string(i), "user" + std::to_string(i) + "@example.com", "Pa55word!" + std::to_string(i * 7919));
+    entry.setUrl("https://service" + std::to_string(i) + ".example.com/login");
+    entry.setCategory("category" + std::to_string(i % 20));
+    entry.setNotes("synthetic entry " + std::to_string(i));
+    vault.addEntry(entry);
+  }
+  vault.commit();
+  vault.compact();
+}
+
+// open time from 1 thread up to maxThreads, doubling
+int benchOpen(int count, unsigned maxThreads) {
+  const std::string file = "bench_open.ovault";
+  std::cout << "Building vault with " << count << " entries...\n";
+  buildVault(file, count);
+
+  std::cout << std::setw(10) << "threads" << std::setw(14) << "open ms" << std::setw(10) << "speedup" << "\n";
+  double baseline = 0;
+  for (unsigned threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+    Vault vault(file);
+    vault.setThreads(threads);
+
+    // best of three, key derivation included
+    double best = 0;
+    for (int run = 0; run < 3; ++run) {
+      double ms = timeMs([&]() { vault.open(BENCH_PASSWORD); });
+      if (vault.getEntryCount() != count) {
+        std::cerr << "Error: opened " << vault.getEntryCount() << " entries\n";
+        return 1;
+      }
+      vault.close();
+      best = (run == 0) ? ms : std::min(best, ms);
+    }
+    if (threads == 1) {
+      baseline = best;
+    }
+
+    std::cout << std::setw(10) << threads << std::setw(14) << std::fixed << std::setprecision(1) << best
+              << std::setw(9) << std::setprecision(2) << baseline / best << "x\n";
+    if (threads == maxThreads) {
+      break;
+    }
+  }
+
+  std::remove(file.c_str());
+  return 0;
+}
+
+// full save time from 1 thread up to maxThreads, doubling
+int benchSave(int count, unsigned maxThreads) {
+  const std::string file = "bench_save.ovault";
+  std::cout << "Building vault with " << count << " entries...\n";
+  buildVault(file, count);
+
+  Vault vault(file);
+  vault.open(BENCH_PASSWORD);
+
+  std::cout << std::setw(10) << "threads" << std::setw(14) << "save ms" << std::setw(10) << "speedup" << "\n";
+  double baseline = 0;
+  for (unsigned threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+    vault.setThreads(threads);
+
+    // best of three
+    double best = 0;
+    for (int run = 0; run < 3; ++run) {
+      double ms = timeMs([&]() { vault.save(); });
+      best = (run == 0) ? ms : std::min(best, ms);
+    }
+    if (threads == 1) {
+      baseline = best;
+    }
+
+    std::cout << std::setw(10) << threads << std::setw(14) << std::fixed << std::setprecision(1) << best
+              << std::setw(9) << std::setprecision(2) << baseline / best << "x\n";
+    if (threads == maxThreads) {
+      break;
+    }
+  }
+
+  vault.close();
+  std::remove(file.c_str());
+  return 0;
+}
+
+// one entry via the offset table against a full open
+int benchLookup(int count) {
+  const std::string file = "bench_lookup.ovault";
+  std::cout << "Building vault with " << count << " entries...\n";
+  buildVault(file, count);
+
+  int id = count / 2;
+  Vault vault(file);
+  double full = timeMs([&]() {
+    vault.open(BENCH_PASSWORD);
+    vault.getEntry(id);
+    vault.close();
+  });
+  double lookup = timeMs([&]() { vault.lookup(BENCH_PASSWORD, id); });
+
+  // both include one key derivation
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "open + get:  " << full << " ms\n";
+  std::cout << "lookup:      " << lookup << " ms\n";
+
+  std::remove(file.c_str());
+  return 0;
+}
+
+// CBC against GCM: raw throughput, then whole vault save and open
+int benchCipher(int count) {
+  CryptoManager crypto;
+  SecureBytes key = crypto.generateKey();
+  std::vector<uint8_t> iv = crypto.generateIV();
+  const size_t RECORD = 64 * 1024;
+  const size_t TOTAL = 256 * 1024 * 1024;
+  std::vector<uint8_t> plaintext(RECORD, 'x');
+
+  std::cout << std::setw(8) << "cipher" << std::setw(16) << "encrypt MB/s" << std::setw(16) << "decrypt MB/s"
+            << std::setw(12) << "save ms" << std::setw(12) << "open ms" << "\n";
+
+  const std::string file = "bench_cipher.ovault";
+  std::cout << std::fixed << std::setprecision(1);
+  for (CipherMode mode : {CipherMode::CBC, CipherMode::GCM}) {
+    std::vector<uint8_t> ciphertext;
+    double encryptMs = timeMs([&]() {
+      for (size_t done = 0; done < TOTAL; done += RECORD) {
+        ciphertext = crypto.encrypt(plaintext, key, iv, mode);
+      }
+    });
+    double decryptMs = timeMs([&]() {
+      for (size_t done = 0; done < TOTAL; done += RECORD) {
+        crypto.decrypt(ciphertext, key, iv, mode);
+      }
+    });
+
+    // same synthetic vault in each cipher
+    std::remove(file.c_str());
+    Vault vault(file);
+    vault.setCipherMode(mode);
+    vault.create(BENCH_PASSWORD);
+    vault.beginBatch();
+    for (int i = 0; i < count; ++i) {
+      vault.addEntry(PasswordEntry(0, "service" + std::to_string(i), "user" + std::to_string(i), "Pa55word!" + std::to_string(i)));
+    }
+    vault.commit();
+    double saveMs = timeMs([&]() { vault.save(); });
+    vault.close();
+    double openMs = timeMs([&]() { vault.open(BENCH_PASSWORD); });
+    vault.close();
+
+    double megabytes = TOTAL / (1024.0 * 1024.0);
+    std::cout << std::setw(8) << (mode == CipherMode::GCM ? "GCM" : "CBC")
+              << std::setw(16) << megabytes / (encryptMs / 1000) << std::setw(16) << megabytes / (decryptMs / 1000)
+              << std::setw(12) << saveMs << std::setw(12) << openMs << "\n";
+  }
+
+  std::remove(file.c_str());
+  return 0;
+}
+
+// column scans and trigram lookups over an open vault, best of ten
+int benchSearch(int count) {
+  const std::string file = "bench_search.ovault";
+  std::cout << "Building vault with " << count << " entries...\n";
+  buildVault(file, count);
+
+  Vault vault(file);
+  vault.open(BENCH_PASSWORD);
+  auto best = [](const std::function<void()>& work) {
+    double fastest = 0;
+    for (int run = 0; run < 10; ++run) {
+      double ms = timeMs(work);
+      fastest = (run == 0) ? ms : std::min(fastest, ms);
+    }
+    return fastest;
+  };
+
+  size_t found = 0;
+  std::cout << std::fixed << std::setprecision(2);
+  // the first substring query builds the trigram index
+  std::cout << "first search: " << timeMs([&]() { found = vault.search("service42").size(); }) << " ms\n";
+  std::cout << "by service:   " << best([&]() { found = vault.search("service~service4242").size(); }) << " ms\n";
+  std::cout << "list order:   " << best([&]() {
+    found = 0;
+    vault.forEachByService([&found](const PasswordEntry&) { ++found; });
+  }) << " ms\n";
+  std::cout << "by category:  " << best([&]() { found = vault.search("category:category7").size(); }) << " ms\n";
+  std::cout << "any field:    " << best([&]() {
+    found = 0;
+    vault.forEachMatch("USER4242@", [&found](const PasswordEntry&) { ++found; });
+  }) << " ms\n";
+  std::cout << "compound:     " << best([&]() {
+    found = 0;
+    vault.forEachMatch("category:category7 user~42 strength>=0 modified<1d", [&found](const PasswordEntry&) { ++found; });
+  }) << " ms\n";
+  std::cout << "fuzzy top 10: " << best([&]() { found = vault.fuzzySearch("srvice4242", 10).size(); }) << " ms\n";
+  std::cout << "categories:   " << best([&]() { found = vault.countByCategory().size(); }) << " ms\n";
+  // synthetic entries are all new: no stale range, then every entry oldest first
+  std::cout << "stale 180d:   " << best([&]() {
+    found = 0;
+    vault.forEachModifiedBefore(time(nullptr) - 180 * 86400, [&found](const PasswordEntry&) { ++found; });
+  }) << " ms\n";
+  std::cout << "all by age:   " << best([&]() {
+    found = 0;
+    vault.forEachModifiedBefore(time(nullptr) + 1, [&found](const PasswordEntry&) { ++found; });
+  }) << " ms\n";
+
+  vault.close();
+  std::remove(file.c_str());
+  return 0;
+}
+
+// case-insensitive substring kernels against lower-cased copies and find
+// over the searched fields of synthetic entries, several sizes and query lengths
+int benchMatch(int count) {
+  std::vector<std::string> fields;
+  for (int i = 0; i < count; ++i) {
+    fields.push_back("Service" + std::to_string(i));
+    fields.push_back("User" + std::to_string(i) + "@Example.com");
+    fields.push_back("https://service" + std::to_string(i) + ".example.com/login");
+    fields.push_back("Category" + std::to_string(i % 20));
+  }
+
+  std::vector<TextMatch::Kernel> kernels;
+  for (auto kernel : {TextMatch::Kernel::Scalar, TextMatch::Kernel::SSE2, TextMatch::Kernel::AVX2}) {
+    if (TextMatch::supported(kernel)) {
+      kernels.push_back(kernel);
+    }
+  }
+
+  std::cout << std::setw(10) << "entries" << std::setw(8) << "query" << std::setw(12) << "copy+find";
+  for (auto kernel : kernels) {
+    std::cout << std::setw(10) << TextMatch::name(kernel);
+  }
+  std::cout << "   (ms per scan)\n" << std::fixed << std::setprecision(2);
+
+  for (int entries = std::min(count, 10000); ; entries = std::min(entries * 10, count)) {
+    size_t used = static_cast<size_t>(entries) * 4;
+    for (std::string query : {"lo", "user", "USER4242", "user4242@example."}) {
+      size_t expected = 0;
+      double copyMs = timeMs([&]() {
+        std::string lowerQuery = query;
+        std::transform(lowerQuery.begin(), lowerQuery.end(), lowerQuery.begin(), ::tolower);
+        for (size_t i = 0; i < used; ++i) {
+          std::string lower = fields[i];
+          std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+          expected += (lower.find(lowerQuery) != std::string::npos);
+        }
+      });
+      std::cout << std::setw(10) << entries << std::setw(8) << query.size() << std::setw(12) << copyMs;
+
+      for (auto kernel : kernels) {
+        size_t found = 0;
+        double ms = timeMs([&]() {
+          for (size_t i = 0; i < used; ++i) {
+            found += TextMatch::containsIgnoreCase(fields[i], query, kernel);
+          }
+        });
+        if (found != expected) {
+          std::cerr << "Error: " << TextMatch::name(kernel) << " found " << found << ", expected " << expected << "\n";
+          return 1;
+        }
+        std::cout << std::setw(10) << ms;
+      }
+      std::cout << "\n";
+    }
+    if (entries == count) {
+      break;
+    }
+  }
+  return 0;
+}
+
+// bulk password generation in passwords per second, one call per password first
+// then generateMany from 1 thread up to maxThreads, doubling
+int benchGenerate(int count, unsigned maxThreads) {
+  std::cout << std::setw(10) << "threads" << std::setw(14) << "ms" << std::setw(16) << "passwords/s" << "\n";
+  std::cout << std::fixed << std::setprecision(1);
+
+  size_t made = 0;
+  double singleMs = timeMs([&]() {
+    for (int i = 0; i < count; ++i) {
+      made += PasswordGenerator::generate(16).size();
+    }
+  });
+  std::cout << std::setw(10) << "single" << std::setw(14) << singleMs << std::setw(16) << std::setprecision(0)
+            << count / (singleMs / 1000) << std::setprecision(1) << "\n";
+
+  for (unsigned threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+    // best of three
+    double best = 0;
+    for (int run = 0; run < 3; ++run) {
+      double ms = timeMs([&]() { made = PasswordGenerator::generateMany(count, 16, threads).size(); });
+      best = (run == 0) ? ms : std::min(best, ms);
+    }
+    if (made != static_cast<size_t>(count) * 17) {
+      std::cerr << "Error: generated " << made << " bytes\n";
+      return 1;
+    }
+
+    std::cout << std::setw(10) << threads << std::setw(14) << best << std::setw(16) << std::setprecision(0)
+              << count / (best / 1000) << std::setprecision(1) << "\n";
+    if (threads == maxThreads) {
+      break;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  std::string bench = (argc >= 2) ? argv[1] : "open";
+
+  try {
+    int count = (argc >= 3) ? std::stoi(argv[2]) : 100000;
+    unsigned threads = (argc >= 4) ? std::stoul(argv[3]) : Utils::defaultThreads();
+    if (bench == "open") {
+      return benchOpen(count, std::max(1u, threads));
+    }
+    if (bench == "save") {
+      return benchSave(count, std::max(1u, threads));
+    }
+    if (bench == "lookup") {
+      return benchLookup(count);
+    }
+    if (bench == "cipher") {
+      return benchCipher(count);
+    }
+    if (bench == "search") {
+      return benchSearch(count);
+    }
+    if (bench == "match") {
+      return benchMatch(count);
+    }
+    if (bench == "generate") {
+      return benchGenerate(count, std::max(1u, threads));
+    }
+
+    std::cerr << "Usage: " << argv[0] << " open|save|lookup|cipher|search|match|generate [entries] [max threads]\n";
+    return 1;
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,51 @@
+#include "mapped_file.hpp"
+#include "exceptions.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// map file
+MappedFile::MappedFile(const std::string &path) : data(nullptr), length(0) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw FileException("Cannot open vault file: " + path);
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    ::close(fd);
+    throw FileException("Cannot open vault file: " + path);
+  }
+  length = info.st_size;
+
+  // empty file has nothing to map, every span() on it fails the bounds check
+  if (length > 0) {
+    void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      ::close(fd);
+      throw FileException("Cannot map vault file: " + path);
+    }
+    data = static_cast<const uint8_t*>(mapped);
+    // one sequential pass on open
+    madvise(mapped, length, MADV_SEQUENTIAL);
+  }
+
+  // mapping stays valid after close
+  ::close(fd);
+}
+
+// unmap
+MappedFile::~MappedFile() {
+  if (data) {
+    munmap(const_cast<uint8_t*>(data), length);
+  }
+}
+
+// checked view into the file
+std::span<const uint8_t> MappedFile::span(size_t offset, size_t count) const {
+  if (offset > length || count > length - offset) {
+    throw CorruptedVaultException("Truncated vault data");
+  }
+  return std::span<const uint8_t>(data + offset, count);
+}
@@ -1,35 +1,59 @@
 #include "password_entry.hpp"
 #include "exceptions.hpp"
+#include "password_generator.hpp"
 #include <sstream>
 #include <iomanip>
 #include <cstring>
+#include <cstdint>
 #include <vector>
+#include <algorithm>
 
 // constructor 1, no vals passed
 PasswordEntry::PasswordEntry() : id(0), service(""), username(""), password(""),
-    url(""), notes(""), category(""), created(std::time(nullptr)), last_modified(std::time(nullptr)) {
+    url(""), notes(""), category(""), created(std::time(nullptr)), last_modified(std::time(nullptr)),
+    strength(PasswordGenerator::calculateStrength("")), secretsLoaded(true) {
 }
 
 // constructor 2, id,service,username,password vals passed
-PasswordEntry::PasswordEntry(int id, const std::string& service, const std::string& username, const std::string& password)
+PasswordEntry::PasswordEntry(int id, const std::string& service, const std::string& username, std::string_view password)
     : id(id), service(service), username(username), password(password), url(""), notes(""),
-      category(""), created(std::time(nullptr)), last_modified(std::time(nullptr)) {
+      category(""), created(std::time(nullptr)), last_modified(std::time(nullptr)),
+      strength(PasswordGenerator::calculateStrength(password)), secretsLoaded(true) {
 }
 
 // constructor 3, all vals passed
 PasswordEntry::PasswordEntry(const PasswordEntry& other) : id(other.id), service(other.service), username(other.username),
     password(other.password), url(other.url), notes(other.notes),
-    category(other.category), created(other.created), last_modified(other.last_modified) {
+    category(other.category), created(other.created), last_modified(other.last_modified),
+    strength(other.strength), secretsLoaded(other.secretsLoaded) {
+}
+
+// move constructor, strings are stolen rather than copied
+PasswordEntry::PasswordEntry(PasswordEntry&& other) noexcept : id(other.id), service(std::move(other.service)),
+    username(std::move(other.username)), password(std::move(other.password)), url(std::move(other.url)),
+    notes(std::move(other.notes)), category(std::move(other.category)), created(other.created),
+    last_modified(other.last_modified), strength(other.strength), secretsLoaded(other.secretsLoaded) {
+  // short secrets were copied out of other's inline buffers, not stolen
+  wipe(other.password);
+  wipe(other.notes);
 }
 
 // destructor, overwrite password
 PasswordEntry::~PasswordEntry() {
-  if (!password.empty()) {
-    volatile char* x = &password[0];
-    for (size_t i = 0; i < password.size(); ++i) {
+  wipe(password);
+  wipe(notes);
+}
+
+// overwrite every byte the string owns, inline buffer included
+void PasswordEntry::wipe(SecureString& value) noexcept {
+  if (value.capacity() > 0) {
+    value.resize(value.capacity());
+    volatile char* x = &value[0];
+    for (size_t i = 0; i < value.size(); ++i) {
       x[i] = 0;
     }
   }
+  value.clear();
 }
 
 // = operator
@@ -44,6 +68,30 @@ PasswordEntry& PasswordEntry::operator=(const PasswordEntry& other) {
     category = other.category;
     created = other.created;
     last_modified = other.last_modified;
+    strength = other.strength;
+    secretsLoaded = other.secretsLoaded;
+  }
+  return *this;
+}
+
+// move = operator
+PasswordEntry& PasswordEntry::operator=(PasswordEntry&& other) noexcept {
+  if (this != &other) {
+    id = other.id;
+    service = std::move(other.service);
+    username = std::move(other.username);
+    wipe(password);
+    password = std::move(other.password);
+    wipe(other.password);
+    url = std::move(other.url);
+    wipe(notes);
+    notes = std::move(other.notes);
+    wipe(other.notes);
+    category = std::move(other.category);
+    created = other.created;
+    last_modified = other.last_modified;
+    strength = other.strength;
+    secretsLoaded = other.secretsLoaded;
   }
   return *this;
 }
@@ -78,6 +126,13 @@ std::ostream& operator<<(std::ostream& os, const PasswordEntry& entry) {
   return os;
 }
 
+// set password, strength follows it
+void PasswordEntry::setPassword(std::string_view p) {
+  password = p;
+  strength = PasswordGenerator::calculateStrength(password);
+  updateModified();
+}
+
 // update last modified time
 void PasswordEntry::updateModified() {
   last_modified = std::time(nullptr);
@@ -90,26 +145,241 @@ std::string PasswordEntry::toString() const {
   return oss.str();
 }
 
-// convert PasswordEntry to str
-std::string PasswordEntry::serialize() const {
-  std::ostringstream oss;
-  oss << id << "|" << service << "|" << username << "|"
-      << password << "|" << url << "|" << notes << "|"
-      << category << "|" << created << "|" << last_modified;
-  return oss.str();
+namespace {
+  // binary record writer, appends to one preallocated string
+  template <typename String>
+  class RecordWriter {
+    private:
+      String &out;
+
+    public:
+      explicit RecordWriter(String &out) : out(out) {
+        out.push_back(static_cast<char>(PasswordEntry::BINARY_FORMAT));
+      }
+
+      // LEB128: 7 bits per byte, high bit set while more follow
+      void varint(uint64_t value) {
+        while (value >= 0x80) {
+          out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+          value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+      }
+
+      void text(std::string_view value) {
+        varint(value.size());
+        out.append(value);
+      }
+
+      // fixed width, same byte order as the rest of the file
+      void time(time_t value) {
+        int64_t wide = value;
+        out.append(reinterpret_cast<const char*>(&wide), sizeof(wide));
+      }
+  };
+
+  // bytes varint(n) takes
+  size_t varintSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+      value >>= 7;
+      ++size;
+    }
+    return size;
+  }
+
+  // binary record reader, one pass, every read checked against the end
+  class RecordReader {
+    private:
+      std::string_view data;
+      size_t position;
+
+      void need(size_t count) const {
+        if (count > data.size() - position) {
+          throw EntryException("Truncated serialized entry");
+        }
+      }
+
+    public:
+      // skips the format byte
+      explicit RecordReader(std::string_view data) : data(data), position(1) {
+      }
+
+      uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+          need(1);
+          uint8_t byte = static_cast<uint8_t>(data[position++]);
+          value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+          if (!(byte & 0x80)) {
+            return value;
+          }
+        }
+        throw EntryException("Invalid varint in serialized entry");
+      }
+
+      // varint that must fit an int
+      int number() {
+        uint64_t value = varint();
+        if (value > static_cast<uint64_t>(INT32_MAX)) {
+          throw EntryException("Invalid number in serialized entry");
+        }
+        return static_cast<int>(value);
+      }
+
+      std::string_view text() {
+        uint64_t length = varint();
+        need(length);
+        std::string_view value = data.substr(position, length);
+        position += length;
+        return value;
+      }
+
+      time_t time() {
+        int64_t wide;
+        need(sizeof(wide));
+        std::memcpy(&wide, data.data() + position, sizeof(wide));
+        position += sizeof(wide);
+        return wide;
+      }
+
+      // trailing bytes mean the record is not what we think it is
+      void finish() const {
+        if (position != data.size()) {
+          throw EntryException("Unexpected data after serialized entry");
+        }
+      }
+  };
+
+  bool isBinary(std::string_view data) {
+    return !data.empty() && static_cast<uint8_t>(data[0]) == PasswordEntry::BINARY_FORMAT;
+  }
+
+  // fields split on '|', for the text format
+  std::vector<std::string> splitText(std::string_view data) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (start <= data.size()) {
+      size_t bar = data.find('|', start);
+      if (bar == std::string_view::npos) {
+        // getline never produced a trailing empty field, neither do we
+        if (start < data.size()) {
+          fields.emplace_back(data.substr(start));
+        }
+        break;
+      }
+      fields.emplace_back(data.substr(start, bar - start));
+      start = bar + 1;
+    }
+    return fields;
+  }
 }
 
-// convert str to PasswordEntry
-PasswordEntry PasswordEntry::deserialize(const std::string& data) {
-  std::istringstream iss(data);
-  std::string field;
-  std::vector<std::string> fields;
-  
-  // delimiter is |
-  while (std::getline(iss, field, '|')) {
-    fields.push_back(field);
+// convert PasswordEntry to binary record
+SecureString PasswordEntry::serialize() const {
+  SecureString out;
+  out.reserve(1 + 6 * 5 + service.size() + username.size() + password.size() + url.size() + notes.size() + category.size() + 2 * sizeof(int64_t));
+  RecordWriter<SecureString> writer(out);
+  writer.varint(static_cast<uint32_t>(id));
+  writer.text(service);
+  writer.text(username);
+  writer.text(password);
+  writer.text(url);
+  writer.text(notes);
+  writer.text(category);
+  writer.time(created);
+  writer.time(last_modified);
+  return out;
+}
+
+// convert record to PasswordEntry
+PasswordEntry PasswordEntry::deserialize(std::string_view data) {
+  if (!isBinary(data)) {
+    return deserializeText(data);
   }
-  
+
+  RecordReader reader(data);
+  PasswordEntry entry;
+  entry.id = reader.number();
+  entry.service = reader.text();
+  entry.username = reader.text();
+  entry.password = reader.text();
+  entry.url = reader.text();
+  entry.notes = reader.text();
+  entry.category = reader.text();
+  entry.created = reader.time();
+  entry.last_modified = reader.time();
+  reader.finish();
+  entry.strength = PasswordGenerator::calculateStrength(entry.password);
+  return entry;
+}
+
+// convert index fields to binary record
+std::string PasswordEntry::serializeIndex() const {
+  std::string out;
+  out.reserve(1 + 4 * 5 + service.size() + username.size() + url.size() + category.size() + 2 * sizeof(int64_t) + 2);
+  RecordWriter<std::string> writer(out);
+  writer.varint(static_cast<uint32_t>(id));
+  writer.text(service);
+  writer.text(username);
+  writer.text(url);
+  writer.text(category);
+  writer.time(created);
+  writer.time(last_modified);
+  writer.varint(static_cast<uint32_t>(strength));
+  return out;
+}
+
+// convert secrets to binary record
+SecureString PasswordEntry::serializeSecrets() const {
+  SecureString out;
+  out.reserve(1 + varintSize(password.size()) + password.size() + varintSize(notes.size()) + notes.size());
+  RecordWriter<SecureString> writer(out);
+  writer.text(password);
+  writer.text(notes);
+  return out;
+}
+
+// convert record to index only PasswordEntry
+PasswordEntry PasswordEntry::deserializeIndex(std::string_view data) {
+  // split records only ever existed in binary
+  if (!isBinary(data)) {
+    throw EntryException("Invalid serialized entry index format");
+  }
+
+  RecordReader reader(data);
+  PasswordEntry entry;
+  entry.id = reader.number();
+  entry.service = reader.text();
+  entry.username = reader.text();
+  entry.url = reader.text();
+  entry.category = reader.text();
+  entry.created = reader.time();
+  entry.last_modified = reader.time();
+  entry.strength = reader.number();
+  reader.finish();
+  entry.secretsLoaded = false;
+  return entry;
+}
+
+// fill password and notes from a secrets record
+void PasswordEntry::loadSecrets(std::string_view data) {
+  if (!isBinary(data)) {
+    throw EntryException("Invalid serialized entry secrets format");
+  }
+
+  RecordReader reader(data);
+  std::string_view newPassword = reader.text();
+  std::string_view newNotes = reader.text();
+  reader.finish();
+  password = newPassword;
+  notes = newNotes;
+  secretsLoaded = true;
+}
+
+// text format: id|service|username|password|url|notes|category|created|modified
+PasswordEntry PasswordEntry::deserializeText(std::string_view data) {
+  std::vector<std::string> fields = splitText(data);
   if (fields.size() != 9) {
     throw EntryException("Invalid serialized entry format");
   }
@@ -124,5 +394,29 @@ PasswordEntry PasswordEntry::deserialize(const std::string& data) {
   entry.category = fields[6];
   entry.created = std::stoll(fields[7]);
   entry.last_modified = std::stoll(fields[8]);
+  entry.strength = PasswordGenerator::calculateStrength(entry.password);
+  std::fill(fields[3].begin(), fields[3].end(), '\0');
+  std::fill(fields[5].begin(), fields[5].end(), '\0');
+  return entry;
+}
+
+// copy without password and notes, secrets are never copied
+PasswordEntry PasswordEntry::withoutSecrets() const {
+  return indexOnly(id, service, username, url, category, created, last_modified, strength);
+}
+
+// index fields only
+PasswordEntry PasswordEntry::indexOnly(int id, std::string_view service, std::string_view username, std::string_view url,
+                                       std::string_view category, time_t created, time_t modified, int strength) {
+  PasswordEntry entry;
+  entry.id = id;
+  entry.service = service;
+  entry.username = username;
+  entry.url = url;
+  entry.category = category;
+  entry.created = created;
+  entry.last_modified = modified;
+  entry.strength = strength;
+  entry.secretsLoaded = false;
   return entry;
 }
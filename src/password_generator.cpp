@@ -1,7 +1,14 @@
 #include "password_generator.hpp"
-#include <random>
+#include "secure_random.hpp"
+#include "utils.hpp"
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <stdexcept>
+#include <openssl/crypto.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 // all possible chars
 const std::string PasswordGenerator::LOWERCASE = "abcdefghijklmnopqrstuvwxyz";
@@ -9,13 +16,57 @@ const std::string PasswordGenerator::UPPERCASE = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
 const std::string PasswordGenerator::DIGITS = "0123456789";
 const std::string PasswordGenerator::SYMBOLS = "!@#$%^&*()_+-=[]{}|;:,.<>?";
 
+namespace {
+  // random bytes drawn per round
+  constexpr size_t RANDOM_BLOCK = 256;
+
+  // rejection sampling without division (Lemire): byte * size spans [0, 256 * size),
+  // the high byte is an index into the set and the low byte falls below 256 % size
+  // for exactly the surplus values that would bias it, those bytes are dropped
+  // kept indices go to picks in order, their count is returned
+  size_t keepUnbiased(const uint8_t *bytes, size_t count, uint32_t size, uint8_t *picks) {
+    const uint32_t threshold = 256 % size;
+    size_t kept = 0;
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i multiplier = _mm_set1_epi16(static_cast<short>(size));
+    const __m128i lowByte = _mm_set1_epi16(0xff);
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold));
+    alignas(16) uint8_t lanes[16];
+    for (; i + 16 <= count; i += 16) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+      __m128i low = _mm_mullo_epi16(_mm_unpacklo_epi8(block, zero), multiplier);
+      __m128i high = _mm_mullo_epi16(_mm_unpackhi_epi8(block, zero), multiplier);
+      __m128i index = _mm_packus_epi16(_mm_srli_epi16(low, 8), _mm_srli_epi16(high, 8));
+      __m128i rest = _mm_packus_epi16(_mm_and_si128(low, lowByte), _mm_and_si128(high, lowByte));
+      // rest >= threshold, unsigned
+      unsigned keep = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(rest, limit), rest));
+      _mm_store_si128(reinterpret_cast<__m128i *>(lanes), index);
+      // every lane is written, only kept ones advance
+      for (int lane = 0; lane < 16; ++lane) {
+        picks[kept] = lanes[lane];
+        kept += (keep >> lane) & 1;
+      }
+    }
+    OPENSSL_cleanse(lanes, sizeof(lanes));
+#endif
+    for (; i < count; ++i) {
+      uint32_t product = bytes[i] * size;
+      picks[kept] = static_cast<uint8_t>(product >> 8);
+      kept += (product & 0xff) >= threshold;
+    }
+    return kept;
+  }
+}
+
 // default generate
-std::string PasswordGenerator::generate(int length) {
+SecureString PasswordGenerator::generate(int length) {
   return generate(length, true, true, true, true);
 }
 
 // generate with charsets
-std::string PasswordGenerator::generate(int length, bool useLowercase, bool useUppercase, bool useDigits, bool useSymbols) {
+SecureString PasswordGenerator::generate(int length, bool useLowercase, bool useUppercase, bool useDigits, bool useSymbols) {
   std::string character_set = getCharacterSet(useLowercase, useUppercase, useDigits, useSymbols);
 
   if (character_set.empty()) {
@@ -26,26 +77,40 @@ std::string PasswordGenerator::generate(int length, bool useLowercase, bool useU
     throw std::invalid_argument("Length of password must be at least 4 characters");
   }
 
-  // random select char by char
-  std::random_device rand;
-  std::mt19937 gen(rand());
-  std::uniform_int_distribution<> distribution(0, character_set.length() - 1);
-
-  std::string password;
-  password.reserve(length);
+  SecureString password(length, '\0');
+  fillFromCharset(password, character_set);
+  return password;
+}
 
-  for (int i = 0; i < length; ++i) {
-    password += character_set[distribution(gen)];
+// bulk generate, workers write straight into their part of the buffer
+SecureString PasswordGenerator::generateMany(size_t count, int length, unsigned threads) {
+  if (length < 4) {
+    throw std::invalid_argument("Length of password must be at least 4 characters");
   }
 
-  return password;
+  const std::string character_set = getCharacterSet(true, true, true, true);
+  const size_t stride = static_cast<size_t>(length) + 1;
+  SecureString passwords(count * stride, '\0');
+  Utils::parallelFor(count, threads, [&](size_t begin, size_t end) {
+    // one random stream per chunk, then the line breaks go over every stride-th char
+    fillFromCharset(std::span<char>(passwords.data() + begin * stride, (end - begin) * stride), character_set);
+    for (size_t i = begin; i < end; ++i) {
+      passwords[i * stride + length] = '\n';
+    }
+  }, 1024);
+  return passwords;
 }
 
 // calculate password strength
-int PasswordGenerator::calculateStrength(const std::string &password) {
+int PasswordGenerator::calculateStrength(std::string_view password) {
   int strength = 0;
   int length = password.length();
 
+  // nothing to score
+  if (length == 0) {
+    return 0;
+  }
+
   // ;ength score 10-40
   if (length >= 16) {
     strength += 40;
@@ -89,7 +154,7 @@ int PasswordGenerator::calculateStrength(const std::string &password) {
   strength += varieties * 10;
 
   // char unique score 10-40
-  std::string sorted = password;
+  SecureString sorted(password);
   std::sort(sorted.begin(), sorted.end());
   auto last = std::unique(sorted.begin(), sorted.end());
   int uniqueChars = std::distance(sorted.begin(), last);
@@ -115,6 +180,29 @@ std::string PasswordGenerator::getStrengthDescription(int strength) {
   return "Very Weak";
 }
 
+// random bytes in blocks, each kept byte becomes one char
+void PasswordGenerator::fillFromCharset(std::span<char> out, std::string_view charset) {
+  if (charset.empty() || charset.size() > 256) {
+    throw std::invalid_argument("Character set must hold 1 to 256 characters");
+  }
+
+  std::array<uint8_t, RANDOM_BLOCK> random;
+  std::array<uint8_t, RANDOM_BLOCK> picks;
+  size_t done = 0;
+  while (done < out.size()) {
+    // no more bytes than the rest needs, allowing for up to half of them rejected
+    size_t draw = std::min(RANDOM_BLOCK, (out.size() - done) * 2);
+    SecureRandom::fill(std::span<uint8_t>(random.data(), draw));
+    size_t kept = std::min(keepUnbiased(random.data(), draw, static_cast<uint32_t>(charset.size()), picks.data()), out.size() - done);
+    for (size_t i = 0; i < kept; ++i) {
+      out[done + i] = charset[picks[i]];
+    }
+    done += kept;
+  }
+  OPENSSL_cleanse(random.data(), random.size());
+  OPENSSL_cleanse(picks.data(), picks.size());
+}
+
 // get character set if bool true
 std::string PasswordGenerator::getCharacterSet(bool useLowercase, bool useUppercase, bool useDigits, bool useSymbols) {
   std::string charset;
@@ -0,0 +1,223 @@
+#include "query.hpp"
+#include "exceptions.hpp"
+#include <cctype>
+#include <charconv>
+#include <map>
+
+namespace {
+  // terms split on spaces, quotes group and are dropped
+  std::vector<std::string> splitTerms(std::string_view expression) {
+    std::vector<std::string> terms;
+    std::string term;
+    bool quoted = false;
+    bool hasTerm = false;
+    for (char c : expression) {
+      if (c == '"') {
+        quoted = !quoted;
+        hasTerm = true;
+      }
+      else if (!quoted && std::isspace(static_cast<unsigned char>(c))) {
+        if (hasTerm) {
+          terms.push_back(term);
+          term.clear();
+          hasTerm = false;
+        }
+      }
+      else {
+        term += c;
+        hasTerm = true;
+      }
+    }
+    if (quoted) {
+      throw QueryException("Unclosed quote");
+    }
+    if (hasTerm) {
+      terms.push_back(term);
+    }
+    return terms;
+  }
+
+  // field for a prefix like user or category, false if unknown
+  bool fieldNamed(const std::string& name, Query::Field& field) {
+    static const std::map<std::string, Query::Field> fields = {
+      {"service", Query::Field::Service},
+      {"user", Query::Field::Username},
+      {"username", Query::Field::Username},
+      {"url", Query::Field::Url},
+      {"category", Query::Field::Category},
+      {"strength", Query::Field::Strength},
+      {"created", Query::Field::Created},
+      {"modified", Query::Field::Modified}
+    };
+    auto found = fields.find(name);
+    if (found == fields.end()) {
+      return false;
+    }
+    field = found->second;
+    return true;
+  }
+
+  // operator at the start of rest, its length through size, false if there is none
+  bool operatorAt(std::string_view rest, Query::Op& op, size_t& size) {
+    size = 2;
+    if (rest.starts_with("<=")) {
+      op = Query::Op::LessEqual;
+    }
+    else if (rest.starts_with(">=")) {
+      op = Query::Op::GreaterEqual;
+    }
+    else {
+      size = 1;
+      if (rest.empty()) {
+        return false;
+      }
+      switch (rest[0]) {
+        case '~':
+          op = Query::Op::Contains;
+          break;
+        case ':':
+        case '=':
+          op = Query::Op::Equals;
+          break;
+        case '<':
+          op = Query::Op::Less;
+          break;
+        case '>':
+          op = Query::Op::Greater;
+          break;
+        default:
+          return false;
+      }
+    }
+    return true;
+  }
+
+  bool parseNumber(std::string_view text, int64_t& number) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), number);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+  }
+
+  // "90d" style age in seconds
+  bool parseAge(std::string_view text, int64_t& seconds) {
+    if (text.size() < 2) {
+      return false;
+    }
+    int64_t unit = 0;
+    switch (text.back()) {
+      case 'h':
+        unit = 3600;
+        break;
+      case 'd':
+        unit = 86400;
+        break;
+      case 'w':
+        unit = 7 * 86400;
+        break;
+      case 'y':
+        unit = 365 * 86400;
+        break;
+      default:
+        return false;
+    }
+    int64_t count = 0;
+    // ages past the int64 range are rejected, not wrapped
+    if (!parseNumber(text.substr(0, text.size() - 1), count) || count < 0 || count > INT64_MAX / unit) {
+      return false;
+    }
+    seconds = count * unit;
+    return true;
+  }
+
+  // "YYYY-MM-DD" as local midnight
+  bool parseDate(std::string_view text, int64_t& timestamp) {
+    int64_t year = 0;
+    int64_t month = 0;
+    int64_t day = 0;
+    if (text.size() != 10 || text[4] != '-' || text[7] != '-' || !parseNumber(text.substr(0, 4), year) ||
+        !parseNumber(text.substr(5, 2), month) || !parseNumber(text.substr(8, 2), day)) {
+      return false;
+    }
+    std::tm date = {};
+    date.tm_year = static_cast<int>(year) - 1900;
+    date.tm_mon = static_cast<int>(month) - 1;
+    date.tm_mday = static_cast<int>(day);
+    date.tm_isdst = -1;
+    timestamp = std::mktime(&date);
+    return month >= 1 && month <= 12 && day >= 1 && day <= 31 && timestamp != -1;
+  }
+
+  // an age bound turns around: younger than 90d is a timestamp after now - 90d
+  Query::Op reverse(Query::Op op) {
+    switch (op) {
+      case Query::Op::Less:
+        return Query::Op::Greater;
+      case Query::Op::LessEqual:
+        return Query::Op::GreaterEqual;
+      case Query::Op::Greater:
+        return Query::Op::Less;
+      case Query::Op::GreaterEqual:
+        return Query::Op::LessEqual;
+      default:
+        return op;
+    }
+  }
+}
+
+// age like 90d in seconds, throws if malformed
+int64_t Query::ageSeconds(std::string_view text) {
+  int64_t seconds = 0;
+  if (!parseAge(text, seconds)) {
+    throw QueryException("Expected an age like 90d: " + std::string(text));
+  }
+  return seconds;
+}
+
+// split expression into clauses, ages measured back from now
+Query Query::parse(std::string_view expression, time_t now) {
+  Query query;
+  for (const std::string& term : splitTerms(expression)) {
+    // leading letters name a field if an operator follows them
+    size_t nameEnd = 0;
+    while (nameEnd < term.size() && std::isalpha(static_cast<unsigned char>(term[nameEnd]))) {
+      ++nameEnd;
+    }
+    Clause clause;
+    size_t opSize = 0;
+    if (!fieldNamed(term.substr(0, nameEnd), clause.field) || !operatorAt(std::string_view(term).substr(nameEnd), clause.op, opSize)) {
+      // anything else is a plain word, "https://..." included
+      query.terms.push_back(Clause{Field::Any, Op::Contains, term});
+      continue;
+    }
+    clause.text = term.substr(nameEnd + opSize);
+    if (clause.text.empty()) {
+      throw QueryException("Missing value in: " + term);
+    }
+
+    bool numeric = (clause.field == Field::Strength || clause.field == Field::Created || clause.field == Field::Modified);
+    if (!numeric) {
+      if (clause.op != Op::Contains && clause.op != Op::Equals) {
+        throw QueryException("Use ~ or : with text fields: " + term);
+      }
+    }
+    else if (clause.field == Field::Strength) {
+      if (clause.op == Op::Contains || !parseNumber(clause.text, clause.number)) {
+        throw QueryException("Expected a number: " + term);
+      }
+    }
+    else {
+      if (clause.op == Op::Contains || clause.op == Op::Equals) {
+        throw QueryException("Use < or > with times: " + term);
+      }
+      int64_t age = 0;
+      if (parseAge(clause.text, age)) {
+        clause.number = static_cast<int64_t>(now) - age;
+        clause.op = reverse(clause.op);
+      }
+      else if (!parseDate(clause.text, clause.number)) {
+        throw QueryException("Expected an age like 90d or a date like 2025-01-31: " + term);
+      }
+    }
+    query.terms.push_back(std::move(clause));
+  }
+  return query;
+}
@@ -0,0 +1,156 @@
+#include "secure_memory.hpp"
+#include <openssl/crypto.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <mutex>
+#include <new>
+#include <algorithm>
+#include <bit>
+
+namespace {
+  // size classes 16, 32, ... 4096
+  const int CLASS_COUNT = std::countr_zero(SecureArena::MAX_BLOCK) - std::countr_zero(SecureArena::MIN_BLOCK) + 1;
+
+  // freed block, the link lives in the block itself
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  struct ArenaState {
+    std::mutex lock;
+    // bump region of the newest arena
+    uint8_t *next = nullptr;
+    uint8_t *end = nullptr;
+    FreeBlock *freeLists[CLASS_COUNT] = {};
+    bool locked = true;
+    size_t used = 0;
+  };
+
+  ArenaState &state() {
+    // never destroyed, blocks may be freed by static destructors at exit
+    static ArenaState *arena = new ArenaState();
+    return *arena;
+  }
+
+  size_t pageSize() {
+    static const size_t size = sysconf(_SC_PAGESIZE);
+    return size;
+  }
+
+  // index of the smallest class that fits size
+  int classOf(size_t size) {
+    size_t block = std::bit_ceil(std::max(size, SecureArena::MIN_BLOCK));
+    return std::countr_zero(block) - std::countr_zero(SecureArena::MIN_BLOCK);
+  }
+
+  // guard page, usable bytes, guard page
+  // returns the usable part, locked if the limit allows it
+  uint8_t *mapGuarded(size_t usable, bool &locked) {
+    size_t page = pageSize();
+    void *mapped = mmap(nullptr, usable + 2 * page, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    uint8_t *body = static_cast<uint8_t*>(mapped) + page;
+    if (mprotect(body, usable, PROT_READ | PROT_WRITE) != 0) {
+      munmap(mapped, usable + 2 * page);
+      throw std::bad_alloc();
+    }
+    // still usable unlocked, the caller records that it is not
+    locked = (mlock(body, usable) == 0);
+    madvise(body, usable, MADV_DONTDUMP);
+    return body;
+  }
+
+  size_t roundToPages(size_t size) {
+    size_t page = pageSize();
+    return (size + page - 1) / page * page;
+  }
+}
+
+// block from the free list, the bump region, or a fresh arena
+void *SecureArena::allocate(size_t size) {
+  ArenaState &arena = state();
+
+  if (size > MAX_BLOCK) {
+    bool locked = true;
+    uint8_t *block = mapGuarded(roundToPages(size), locked);
+    std::lock_guard<std::mutex> guard(arena.lock);
+    arena.locked = arena.locked && locked;
+    arena.used += size;
+    return block;
+  }
+
+  int index = classOf(size);
+  size_t blockSize = MIN_BLOCK << index;
+  std::lock_guard<std::mutex> guard(arena.lock);
+  arena.used += blockSize;
+
+  if (arena.freeLists[index]) {
+    FreeBlock *block = arena.freeLists[index];
+    arena.freeLists[index] = (*block).next;
+    (*block).next = nullptr;
+    return block;
+  }
+
+  if (static_cast<size_t>(arena.end - arena.next) < blockSize) {
+    // old arena's tail is left unused, classes do not split
+    bool locked = true;
+    try {
+      arena.next = mapGuarded(ARENA_SIZE, locked);
+    }
+    catch (...) {
+      arena.used -= blockSize;
+      throw;
+    }
+    arena.end = arena.next + ARENA_SIZE;
+    arena.locked = arena.locked && locked;
+  }
+
+  // every class is a multiple of 16, so blocks stay 16 byte aligned
+  uint8_t *block = arena.next;
+  arena.next += blockSize;
+  return block;
+}
+
+// wipe, then recycle or unmap
+void SecureArena::deallocate(void *block, size_t size) noexcept {
+  if (!block) {
+    return;
+  }
+  ArenaState &arena = state();
+
+  if (size > MAX_BLOCK) {
+    size_t usable = roundToPages(size);
+    OPENSSL_cleanse(block, usable);
+    munlock(block, usable);
+    munmap(static_cast<uint8_t*>(block) - pageSize(), usable + 2 * pageSize());
+    std::lock_guard<std::mutex> guard(arena.lock);
+    arena.used -= size;
+    return;
+  }
+
+  int index = classOf(size);
+  size_t blockSize = MIN_BLOCK << index;
+  OPENSSL_cleanse(block, blockSize);
+
+  std::lock_guard<std::mutex> guard(arena.lock);
+  FreeBlock *freed = static_cast<FreeBlock*>(block);
+  (*freed).next = arena.freeLists[index];
+  arena.freeLists[index] = freed;
+  arena.used -= blockSize;
+}
+
+// locked so far
+bool SecureArena::isLocked() {
+  ArenaState &arena = state();
+  std::lock_guard<std::mutex> guard(arena.lock);
+  return arena.locked;
+}
+
+// live bytes
+size_t SecureArena::inUse() {
+  ArenaState &arena = state();
+  std::lock_guard<std::mutex> guard(arena.lock);
+  return arena.used;
+}
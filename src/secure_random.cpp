@@ -0,0 +1,105 @@
+#include "secure_random.hpp"
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <pthread.h>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+  // bumped in every child after fork(), so a copied buffer is never reused
+  std::atomic<unsigned> forkGeneration(0);
+
+  void onFork() {
+    forkGeneration.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // registered once per process
+  const int forkHandler = pthread_atfork(nullptr, nullptr, onFork);
+
+  struct RandomPool {
+    uint8_t buffer[SecureRandom::BUFFER_SIZE];
+    // next unused byte, BUFFER_SIZE means empty
+    size_t next;
+    unsigned generation;
+
+    RandomPool() : next(SecureRandom::BUFFER_SIZE), generation(0) {
+    }
+
+    ~RandomPool() {
+      drop();
+    }
+
+    // wipe whatever was not handed out
+    void drop() {
+      OPENSSL_cleanse(buffer, sizeof(buffer));
+      next = sizeof(buffer);
+    }
+
+    // fresh bytes from the DRBG, which reseeds itself
+    void refill() {
+      if (RAND_bytes(buffer, sizeof(buffer)) != 1) {
+        drop();
+        throw std::runtime_error("random generator failed");
+      }
+      next = 0;
+    }
+
+    void take(uint8_t* out, size_t count) {
+      unsigned current = forkGeneration.load(std::memory_order_relaxed);
+      if (generation != current) {
+        // parent and child would otherwise hand out the same bytes
+        drop();
+        generation = current;
+      }
+
+      while (count > 0) {
+        if (next == sizeof(buffer)) {
+          refill();
+        }
+        size_t chunk = std::min(count, sizeof(buffer) - next);
+        std::memcpy(out, buffer + next, chunk);
+        // bytes given out are not kept around
+        OPENSSL_cleanse(buffer + next, chunk);
+        next += chunk;
+        out += chunk;
+        count -= chunk;
+      }
+    }
+  };
+
+  thread_local RandomPool pool;
+}
+
+// fill buffer
+void SecureRandom::fill(std::span<uint8_t> out) {
+  (void)forkHandler;
+  if (out.size() >= BUFFER_SIZE) {
+    if (RAND_bytes(out.data(), out.size()) != 1) {
+      throw std::runtime_error("random generator failed");
+    }
+    return;
+  }
+  pool.take(out.data(), out.size());
+}
+
+// draw 32 bits, retry the few values that would bias the low end
+uint32_t SecureRandom::uniform(uint32_t bound) {
+  if (bound == 0) {
+    throw std::invalid_argument("bound must be positive");
+  }
+
+  // largest multiple of bound that fits in 32 bits
+  uint32_t limit = UINT32_MAX - (UINT32_MAX % bound);
+  uint32_t value;
+  do {
+    fill(std::span<uint8_t>(reinterpret_cast<uint8_t*>(&value), sizeof(value)));
+  } while (value >= limit);
+  return value % bound;
+}
+
+// wipe now
+void SecureRandom::release() {
+  pool.drop();
+}
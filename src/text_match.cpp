@@ -0,0 +1,202 @@
+#include "text_match.hpp"
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define TEXT_MATCH_SSE2 1
+#if defined(__GNUC__)
+#define TEXT_MATCH_AVX2 1
+#endif
+#endif
+
+// helpers are force inlined so the avx2 kernel gets them vex encoded,
+// mixing in legacy sse code costs more than the wider compares save
+#define TEXT_MATCH_INLINE inline __attribute__((always_inline))
+
+namespace {
+  TEXT_MATCH_INLINE char fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+  }
+
+  // compare count bytes ignoring case
+  TEXT_MATCH_INLINE bool equalFolded(const char* text, const char* query, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      if (fold(text[i]) != fold(query[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // positions from start up to the last one query fits at
+  TEXT_MATCH_INLINE bool scanScalar(std::string_view text, std::string_view query, size_t start) {
+    size_t n = query.size();
+    char first = fold(query[0]);
+    for (size_t i = start; i + n <= text.size(); ++i) {
+      if (fold(text[i]) == first && equalFolded(text.data() + i + 1, query.data() + 1, n - 1)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool containsScalar(std::string_view text, std::string_view query) {
+    return scanScalar(text, query, 0);
+  }
+
+#ifdef TEXT_MATCH_SSE2
+  TEXT_MATCH_INLINE __m128i fold16(__m128i c) {
+    // signed compare, bytes >= 0x80 are negative and never upper case
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(c, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+  }
+
+  TEXT_MATCH_INLINE bool scanSSE2(std::string_view text, std::string_view query) {
+    const size_t n = query.size();
+    const char* data = text.data();
+    const __m128i first = _mm_set1_epi8(fold(query.front()));
+    const __m128i last = _mm_set1_epi8(fold(query.back()));
+
+    // block at i covers start positions i..i+15, the last byte of each sits n-1 further on
+    size_t i = 0;
+    for (; i + n - 1 + 16 <= text.size(); i += 16) {
+      __m128i head = fold16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+      __m128i tail = fold16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + n - 1)));
+      unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+      while (mask != 0) {
+        size_t at = i + __builtin_ctz(mask);
+        if (n <= 2 || equalFolded(data + at + 1, query.data() + 1, n - 2)) {
+          return true;
+        }
+        mask &= mask - 1;
+      }
+    }
+    return scanScalar(text, query, i);
+  }
+
+  bool containsSSE2(std::string_view text, std::string_view query) {
+    return scanSSE2(text, query);
+  }
+#endif
+
+#ifdef TEXT_MATCH_AVX2
+  __attribute__((target("avx2"))) __m256i fold32(__m256i c) {
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), c));
+    return _mm256_or_si256(c, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+  }
+
+  // one 32 byte block of start positions from i, 32 + n - 1 bytes must be readable
+  __attribute__((target("avx2"))) bool blockAVX2(const char* data, size_t i, std::string_view query, __m256i first, __m256i last) {
+    const size_t n = query.size();
+    __m256i head = fold32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+    __m256i tail = fold32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + n - 1)));
+    unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last)));
+    while (mask != 0) {
+      size_t at = i + __builtin_ctz(mask);
+      if (n <= 2 || equalFolded(data + at + 1, query.data() + 1, n - 2)) {
+        return true;
+      }
+      mask &= mask - 1;
+    }
+    return false;
+  }
+
+  __attribute__((target("avx2"))) bool containsAVX2(std::string_view text, std::string_view query) {
+    const size_t n = query.size();
+    // not even one 32 byte block, do not touch the ymm registers at all
+    if (text.size() < n - 1 + 32) {
+      return scanSSE2(text, query);
+    }
+    const char* data = text.data();
+    const __m256i first = _mm256_set1_epi8(fold(query.front()));
+    const __m256i last = _mm256_set1_epi8(fold(query.back()));
+
+    size_t i = 0;
+    for (; i + n - 1 + 32 <= text.size(); i += 32) {
+      if (blockAVX2(data, i, query, first, last)) {
+        return true;
+      }
+    }
+    // rest as one block ending at the last position, overlapping what was already checked
+    size_t end = text.size() - (n - 1);
+    return i < end && blockAVX2(data, end - 32, query, first, last);
+  }
+#endif
+
+  using Matcher = bool (*)(std::string_view, std::string_view);
+
+  Matcher matcherFor(TextMatch::Kernel kernel) {
+    switch (kernel) {
+#ifdef TEXT_MATCH_AVX2
+      case TextMatch::Kernel::AVX2:
+        return containsAVX2;
+#endif
+#ifdef TEXT_MATCH_SSE2
+      case TextMatch::Kernel::SSE2:
+        return containsSSE2;
+#endif
+      default:
+        return containsScalar;
+    }
+  }
+}
+
+namespace TextMatch {
+  bool supported(Kernel kernel) {
+    switch (kernel) {
+      case Kernel::Scalar:
+        return true;
+      case Kernel::SSE2:
+#ifdef TEXT_MATCH_SSE2
+        return true;
+#else
+        return false;
+#endif
+      case Kernel::AVX2:
+#ifdef TEXT_MATCH_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+    return false;
+  }
+
+  Kernel best() {
+    static const Kernel kernel = supported(Kernel::AVX2) ? Kernel::AVX2 : supported(Kernel::SSE2) ? Kernel::SSE2 : Kernel::Scalar;
+    return kernel;
+  }
+
+  const char* name(Kernel kernel) {
+    switch (kernel) {
+      case Kernel::AVX2:
+        return "avx2";
+      case Kernel::SSE2:
+        return "sse2";
+      default:
+        return "scalar";
+    }
+  }
+
+  bool containsIgnoreCase(std::string_view text, std::string_view query, Kernel kernel) {
+    if (query.empty()) {
+      return true;
+    }
+    if (query.size() > text.size()) {
+      return false;
+    }
+    return matcherFor(kernel)(text, query);
+  }
+
+  bool containsIgnoreCase(std::string_view text, std::string_view query) {
+    static const Matcher matcher = matcherFor(best());
+    if (query.empty()) {
+      return true;
+    }
+    if (query.size() > text.size()) {
+      return false;
+    }
+    return matcher(text, query);
+  }
+}
@@ -0,0 +1,136 @@
+#include "trigram_index.hpp"
+#include <algorithm>
+#include <iterator>
+#include <cctype>
+
+namespace {
+  uint32_t fold(char c) {
+    return static_cast<uint8_t>(std::tolower(static_cast<unsigned char>(c)));
+  }
+
+  // every trigram of text, lower-cased and packed into the low 24 bits
+  void appendGrams(std::string_view text, std::vector<uint32_t>& grams) {
+    if (text.size() < TrigramIndex::GRAM) {
+      return;
+    }
+    uint32_t gram = (fold(text[0]) << 8) | fold(text[1]);
+    for (size_t i = 2; i < text.size(); ++i) {
+      gram = ((gram << 8) | fold(text[i])) & 0xFFFFFF;
+      grams.push_back(gram);
+    }
+  }
+}
+
+// distinct trigrams of all fields, sorted
+std::vector<uint32_t> TrigramIndex::gramsOf(Fields fields) {
+  std::vector<uint32_t> grams;
+  for (std::string_view field : fields) {
+    appendGrams(field, grams);
+  }
+  std::sort(grams.begin(), grams.end());
+  grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+  return grams;
+}
+
+// add id to the sorted posting list of gram
+void TrigramIndex::insert(uint32_t gram, int id) {
+  std::vector<int>& list = postings[gram];
+  // new ids are the largest so far, appending is the common case
+  if (list.empty() || list.back() < id) {
+    list.push_back(id);
+    return;
+  }
+  auto at = std::lower_bound(list.begin(), list.end(), id);
+  if (*at != id) {
+    list.insert(at, id);
+  }
+}
+
+// take id out of the posting list of gram, empty lists are dropped
+void TrigramIndex::erase(uint32_t gram, int id) {
+  auto found = postings.find(gram);
+  if (found == postings.end()) {
+    return;
+  }
+  std::vector<int>& list = found->second;
+  auto at = std::lower_bound(list.begin(), list.end(), id);
+  if (at != list.end() && *at == id) {
+    list.erase(at);
+  }
+  if (list.empty()) {
+    postings.erase(found);
+  }
+}
+
+void TrigramIndex::add(int id, Fields fields) {
+  for (uint32_t gram : gramsOf(fields)) {
+    insert(gram, id);
+  }
+}
+
+void TrigramIndex::remove(int id, Fields fields) {
+  for (uint32_t gram : gramsOf(fields)) {
+    erase(gram, id);
+  }
+}
+
+// touch only the trigrams that differ between old and new fields
+void TrigramIndex::update(int id, Fields oldFields, Fields newFields) {
+  std::vector<uint32_t> before = gramsOf(oldFields);
+  std::vector<uint32_t> after = gramsOf(newFields);
+
+  std::vector<uint32_t> changed;
+  std::set_difference(before.begin(), before.end(), after.begin(), after.end(), std::back_inserter(changed));
+  for (uint32_t gram : changed) {
+    erase(gram, id);
+  }
+  changed.clear();
+  std::set_difference(after.begin(), after.end(), before.begin(), before.end(), std::back_inserter(changed));
+  for (uint32_t gram : changed) {
+    insert(gram, id);
+  }
+}
+
+void TrigramIndex::clear() {
+  postings.clear();
+}
+
+// ids holding every trigram of query, nullopt if query is too short
+std::optional<std::vector<int>> TrigramIndex::candidates(std::string_view query) const {
+  std::vector<uint32_t> grams = gramsOf({query});
+  if (grams.empty()) {
+    return std::nullopt;
+  }
+
+  // shortest list first, each later list only filters it
+  std::vector<const std::vector<int>*> lists;
+  for (uint32_t gram : grams) {
+    auto found = postings.find(gram);
+    if (found == postings.end()) {
+      return std::vector<int>();
+    }
+    lists.push_back(&found->second);
+  }
+  std::sort(lists.begin(), lists.end(), [](const std::vector<int>* a, const std::vector<int>* b) {
+    return a->size() < b->size();
+  });
+
+  std::vector<int> result = *lists[0];
+  for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+    const std::vector<int>& list = *lists[i];
+    // both sorted: search forward from the last hit
+    auto from = list.begin();
+    size_t kept = 0;
+    for (int id : result) {
+      from = std::lower_bound(from, list.end(), id);
+      if (from == list.end()) {
+        break;
+      }
+      if (*from == id) {
+        result[kept++] = id;
+      }
+    }
+    result.resize(kept);
+  }
+  return result;
+}
@@ -1,7 +1,14 @@
 #include "utils.hpp"
+#include "text_match.hpp"
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+#include <cctype>
 // for turning off terminal echo
 #include <termios.h>
 #include <unistd.h>
@@ -28,9 +35,14 @@ namespace Utils {
     return ss.str();
   }
 
+  // compare in place, no lowercased copies
+  bool containsIgnoreCase(std::string_view text, std::string_view query) {
+    return TextMatch::containsIgnoreCase(text, query);
+  }
+
   // read password from stdin
   // turn off terminal echo first
-  std::string readPassword(const std::string& prompt) {
+  SecureString readPassword(const std::string& prompt) {
     // from stackoverflow
     std::cout << prompt;
     
@@ -40,7 +52,7 @@ namespace Utils {
     newSettings.c_lflag &= ~ECHO;
     tcsetattr(STDIN_FILENO, TCSANOW, &newSettings);
     
-    std::string password;
+    SecureString password;
     std::getline(std::cin, password);
     
     tcsetattr(STDIN_FILENO, TCSANOW, &oldSettings);
@@ -49,4 +61,62 @@ namespace Utils {
     return password;
   }
 
+  // core count
+  unsigned defaultThreads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // chunked parallel loop
+  // workers pull fixed size chunks so uneven records still balance out
+  void parallelFor(size_t count, unsigned threads, const std::function<void(size_t, size_t)>& work, size_t grain) {
+    const size_t CHUNK = std::max<size_t>(1, grain);
+    size_t chunks = (count + CHUNK - 1) / CHUNK;
+    threads = std::max(1u, std::min<unsigned>(threads, chunks));
+
+    // not worth a thread
+    if (threads == 1) {
+      if (count > 0) {
+        work(0, count);
+      }
+      return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex errorLock;
+
+    auto worker = [&]() {
+      while (!failed) {
+        size_t begin = next.fetch_add(CHUNK);
+        if (begin >= count) {
+          return;
+        }
+        try {
+          work(begin, std::min(begin + CHUNK, count));
+        }
+        catch (...) {
+          std::lock_guard<std::mutex> guard(errorLock);
+          if (!error) {
+            error = std::current_exception();
+          }
+          failed = true;
+        }
+      }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i) {
+      pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) {
+      thread.join();
+    }
+
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
 }
@@ -1,30 +1,70 @@
 #include "vault.hpp"
 #include "utils.hpp"
+#include "mapped_file.hpp"
 #include <fstream>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <openssl/sha.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+  // flush a file or directory to disk
+  bool syncPath(const std::string &path, int flags) {
+    int fd = ::open(path.c_str(), flags);
+    if (fd < 0) {
+      return false;
+    }
+    bool synced = fsync(fd) == 0;
+    return (::close(fd) == 0) && synced;
+  }
+
+  // directory whose entry a rename of path changes
+  std::string directoryOf(const std::string &path) {
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    return parent.empty() ? "." : parent.string();
+  }
+}
 
 // constructor
-Vault::Vault(const std::string &filename) : filename(filename), iterations(100000), isOpen(false), cryptography(std::make_unique<CryptoManager>()), nextId(1) {
+Vault::Vault(const std::string &filename) : filename(filename), version(CURRENT_VERSION), iterations(100000), flags(FLAG_SPLIT_RECORDS), tableOffset(0), cipherMode(CipherMode::GCM), fileMode(CipherMode::GCM), isOpen(false), threads(0), cryptography(std::make_unique<CryptoManager>()), nextId(1),
+    journaling(true), journalBytes(0), snapshotBytes(0), writeCount(0), inBatch(false), batchNextId(1) {
 }
 
 // destructor
+// every mutation is already on disk (journal or snapshot), so just close
 Vault::~Vault() {
-  if (isOpen) {
-    try {
-      save();
-      close();
-    }
-    catch (...) {
-      // none
-    }
-  }
+  close();
+  wipeKey();
+}
 
-  // wipe key
+// wipe and drop the data key, cached key schedules go with it
+void Vault::wipeKey() {
   if (!encryption_key.empty()) {
     (*cryptography).wipe(encryption_key.data(), encryption_key.size());
+    encryption_key.clear();
   }
+  CryptoManager::releaseCachedKeys();
+}
+
+// associated data for a record: its role and position
+// binds each record to where it belongs so records cannot be swapped (GCM)
+Vault::AssociatedData Vault::associatedData(RecordRole role, int64_t position) {
+  AssociatedData aad;
+  int roleValue = role;
+  std::memcpy(aad.data(), &roleValue, sizeof(int));
+  std::memcpy(aad.data() + sizeof(int), &position, sizeof(int64_t));
+  return aad;
+}
+
+// configured worker count or one per core
+unsigned Vault::getThreads() const {
+  return threads ? threads : Utils::defaultThreads();
 }
 
 // copy magic number
@@ -33,14 +73,14 @@ void Vault::copyMagicNumber(char *dest, const char *src) {
 }
 
 // hash password
-std::vector<uint8_t> Vault::hashPassword(const std::string &password) {
+std::vector<uint8_t> Vault::hashPassword(std::string_view password) {
   std::vector<uint8_t> hash(HASH_SIZE);
-  SHA256(reinterpret_cast<const unsigned char*>(password.c_str()), password.length(), hash.data());
+  SHA256(reinterpret_cast<const unsigned char*>(password.data()), password.length(), hash.data());
   return hash;
 }
 
 // check password against hash
-void Vault::verifyPassword(const std::string &password) {
+void Vault::verifyPassword(std::string_view password) {
   std::vector<uint8_t> hash = hashPassword(password);
   std::vector<uint8_t> storedHash = Utils::stringToBytes(master_password_hash);
 
@@ -50,7 +90,7 @@ void Vault::verifyPassword(const std::string &password) {
 }
 
 //
-void Vault::create(const std::string &masterPassword) {
+void Vault::create(std::string_view masterPassword) {
   if (isOpen) {
     throw CustomException("Vault is already open");
   }
@@ -62,9 +102,18 @@ void Vault::create(const std::string &masterPassword) {
     throw FileException("Vault file already exists: " + filename);
   }
 
-  // generate salt and key
+  // journal left over from a deleted vault would replay with the wrong key
+  std::remove(journalFilename().c_str());
+
+  // generate salt and keys
+  version = CURRENT_VERSION;
+  flags = FLAG_SPLIT_RECORDS;
+  tableOffset = 0;
+  fileMode = cipherMode;
   salt = (*cryptography).generateSalt();
-  encryption_key = (*cryptography).deriveKey(masterPassword, salt);
+  SecureBytes kek = (*cryptography).deriveKey(masterPassword, salt);
+  generateWrappedKey(kek);
+  (*cryptography).wipe(kek.data(), kek.size());
   master_password_hash = Utils::bytesToString(hashPassword(masterPassword));
 
   // Create empty vault file
@@ -81,7 +130,7 @@ void Vault::create(const std::string &masterPassword) {
   std::memcpy(countBytes.data(), &count, sizeof(int));
 
   auto iv = (*cryptography).generateIV();
-  auto encrypted = (*cryptography).encrypt(countBytes, encryption_key, iv);
+  auto encrypted = (*cryptography).encrypt(countBytes, encryption_key, iv, fileMode, associatedData(ROLE_COUNT, 0));
 
   file.write(reinterpret_cast<const char*>(iv.data()), iv.size());
   int encryptedSize = encrypted.size();
@@ -90,138 +139,266 @@ void Vault::create(const std::string &masterPassword) {
   // Write encrypted data
   file.write(reinterpret_cast<const char*>(encrypted.data()), encrypted.size());
   file.close();
+
+  journalBytes = 0;
+  snapshotBytes = std::filesystem::file_size(filename);
   isOpen = true;
 }
 
+// derive key from password
+// v1 uses it directly, v2 uses it to unwrap the data key
+void Vault::unlockKey(std::string_view password) {
+  wipeKey();
+  SecureBytes kek = (*cryptography).deriveKey(password, salt);
+  if (version == 1) {
+    encryption_key = kek;
+  }
+  else {
+    try {
+      encryption_key = (*cryptography).unwrapKey(wrapped_key, kek);
+    }
+    catch (const std::runtime_error &e) {
+      (*cryptography).wipe(kek.data(), kek.size());
+      throw CorruptedVaultException("Failed to unwrap vault key");
+    }
+  }
+  (*cryptography).wipe(kek.data(), kek.size());
+}
+
+// new data key
+void Vault::generateWrappedKey(const SecureBytes &kek) {
+  wipeKey();
+  encryption_key = (*cryptography).generateKey();
+  wrapped_key = (*cryptography).wrapKey(encryption_key, kek);
+}
+
 // write header to file
-void Vault::writeHeader(std::ofstream &file) {
+void Vault::writeHeader(std::ostream &file) {
   char magic[MAGIC_SIZE + 1] = {0};
   copyMagicNumber(magic, "OVLT");
 
   // write magic,version,salt,iters,hash
-  int version = 1;
   file.write(magic, MAGIC_SIZE);
   file.write(reinterpret_cast<const char*>(&version), sizeof(int));
   file.write(reinterpret_cast<const char*>(salt.data()), salt.size());
   file.write(reinterpret_cast<const char*>(&iterations), sizeof(int));
   std::vector<uint8_t> hash = Utils::stringToBytes(master_password_hash);
   file.write(reinterpret_cast<const char*>(hash.data()), HASH_SIZE);
+  int written = MAGIC_SIZE + sizeof(int) + SALT_SIZE + sizeof(int) + HASH_SIZE;
+
+  // wrapped data key
+  if (version >= 2) {
+    file.write(reinterpret_cast<const char*>(wrapped_key.data()), WRAPPED_KEY_SIZE);
+    file.write(reinterpret_cast<const char*>(&flags), sizeof(int));
+    file.write(reinterpret_cast<const char*>(&tableOffset), sizeof(int64_t));
+    int mode = static_cast<int>(fileMode);
+    file.write(reinterpret_cast<const char*>(&mode), sizeof(int));
+    written += WRAPPED_KEY_SIZE + sizeof(int) + sizeof(int64_t) + sizeof(int);
+  }
 
   // extra space
-  int written = MAGIC_SIZE + sizeof(int) + SALT_SIZE + sizeof(int) + HASH_SIZE;
   int padding = HEADER_SIZE - written;
   std::vector<char> reserved(padding, 0);
   file.write(reserved.data(), padding);
 }
 
 // open vault
-void Vault::open(const std::string &masterPassword) {
+void Vault::open(std::string_view masterPassword) {
   if (isOpen) {
     throw CustomException("Vault is already open");
   }
 
-  std::ifstream file(filename, std::ios::binary);
-  if (!file) {
-    throw FileException("Cannot open vault file: " + filename);
-  }
+  // read only map, records are decrypted straight out of it
+  MappedFile file(filename);
 
   try {
     readHeader(file);
     verifyPassword(masterPassword);
 
     // derive key
-    encryption_key = (*cryptography).deriveKey(masterPassword, salt);
-
-    // read iv,size,count
-    int encryptedCountSize = 0;
-    std::vector<uint8_t> iv(16);
-    file.read(reinterpret_cast<char*>(iv.data()), iv.size());
-    file.read(reinterpret_cast<char*>(&encryptedCountSize), sizeof(int));
-    std::vector<uint8_t> encryptedCount(encryptedCountSize);
-    file.read(reinterpret_cast<char*>(encryptedCount.data()), encryptedCountSize);
-    auto decryptedCount = (*cryptography).decrypt(encryptedCount, encryption_key, iv);
-
+    unlockKey(masterPassword);
+
+    size_t position = HEADER_SIZE;
+    auto nextRecord = [&]() {
+      Record record = readRecord(file, position);
+      position = record.end;
+      return record;
+    };
+
+    // count
+    Record countRecord = nextRecord();
+    auto decryptedCount = (*cryptography).decrypt(countRecord.data, encryption_key, countRecord.iv, fileMode, associatedData(ROLE_COUNT, 0));
     int count = 0;
+    if (decryptedCount.size() != sizeof(int)) {
+      throw CorruptedVaultException("Invalid entry count");
+    }
     std::memcpy(&count, decryptedCount.data(), sizeof(int));
+    if (count < 0) {
+      throw CorruptedVaultException("Invalid entry count");
+    }
 
-    // read entries
-    entries.clear();
-    nextId = 1;
-
-    // for every entry
+    // offset table, one index record (and secrets record when split) per entry
+    bool split = flags & FLAG_SPLIT_RECORDS;
+    std::vector<Record> indexRecords;
+    std::vector<Record> secretRecords;
+    indexRecords.reserve(count);
     for (int i = 0; i < count; ++i) {
-      // read iv, size, encrypted
-      int entrySize = 0;
-      file.read(reinterpret_cast<char*>(iv.data()), iv.size());
-      file.read(reinterpret_cast<char*>(&entrySize), sizeof(int));
-      std::vector<uint8_t> encryptedEntry(entrySize);
-      file.read(reinterpret_cast<char*>(encryptedEntry.data()), entrySize);
+      indexRecords.push_back(nextRecord());
+      if (split) {
+        secretRecords.push_back(nextRecord());
+      }
+    }
 
-      // decrypt entry
-      auto decryptedEntry = (*cryptography).decrypt(encryptedEntry, encryption_key, iv);
-      std::string entryStr = Utils::bytesToString(decryptedEntry);
+    // offset table follows the last entry, check it is all there
+    if ((flags & FLAG_OFFSET_TABLE) && tableOffset > 0) {
+      if (static_cast<int64_t>(position) != tableOffset) {
+        throw CorruptedVaultException("Offset table does not follow entries");
+      }
+      nextRecord();
+    }
 
-      // convert back to obj
-      PasswordEntry entry = PasswordEntry::deserialize(entryStr);
-      entries[entry.getId()] = entry;
+    // records are independent, decrypt them across the pool
+    std::vector<PasswordEntry> loaded(count);
+    std::vector<SealedSecrets> sealed(count);
+    Utils::parallelFor(count, getThreads(), [&](size_t begin, size_t end) {
+      // buffers reused for every record in the chunk
+      // locked, records from older files still hold passwords
+      SecureBytes plain;
+      for (size_t i = begin; i < end; ++i) {
+        size_t needed = CryptoManager::maxDecryptedSize(indexRecords[i].data.size(), fileMode);
+        if (plain.size() < needed) {
+          plain.resize(needed);
+        }
+        size_t length = (*cryptography).decrypt(indexRecords[i].data, encryption_key, indexRecords[i].iv, plain, fileMode, associatedData(ROLE_INDEX, i));
+        // parsed in place, no copy of the plaintext
+        std::string_view entryStr(reinterpret_cast<const char*>(plain.data()), length);
+
+        if (split) {
+          // secrets record is kept encrypted, copied out of the map
+          loaded[i] = PasswordEntry::deserializeIndex(entryStr);
+          sealed[i].iv.assign(secretRecords[i].iv.begin(), secretRecords[i].iv.end());
+          sealed[i].data.assign(secretRecords[i].data.begin(), secretRecords[i].data.end());
+        }
+        else {
+          // unsplit record from an older file, split it now
+          PasswordEntry entry = PasswordEntry::deserialize(entryStr);
+          sealed[i] = sealSecrets(entry);
+          loaded[i] = entry.withoutSecrets();
+        }
+      }
+      (*cryptography).wipe(plain.data(), plain.size());
+    });
 
-      if (entry.getId() >= nextId) {
-        nextId = entry.getId() + 1;
+    // merge
+    secrets.clear();
+    columns.clear();
+    nextId = 1;
+    for (int i = 0; i < count; ++i) {
+      int id = loaded[i].getId();
+      columns.put(loaded[i]);
+      secrets[id] = std::move(sealed[i]);
+      if (id >= nextId) {
+        nextId = id + 1;
       }
     }
 
-    // close
-    file.close();
+    snapshotBytes = file.size();
+
+    replayJournal();
     isOpen = true;
   }
-  catch (const CryptographyException &e) {
-    file.close();
-    throw CorruptedVaultException("Failed to decrypt vault data");
+  catch (const CustomException &e) {
+    throw;
   }
   catch (const std::exception &e) {
-    file.close();
-    throw;
+    // bad padding or unparsable fields, the password already checked out
+    throw CorruptedVaultException("Failed to decrypt vault data");
+  }
+}
+
+// one record: iv, size, encrypted
+Vault::Record Vault::readRecord(const MappedFile &file, size_t offset) {
+  const size_t IV_SIZE = 16;
+  Record record;
+  record.iv = file.span(offset, IV_SIZE);
+  int size = file.read<int>(offset + IV_SIZE);
+  if (size <= 0) {
+    throw CorruptedVaultException("Invalid record size");
   }
+  record.data = file.span(offset + IV_SIZE + sizeof(int), size);
+  record.end = offset + IV_SIZE + sizeof(int) + size;
+  return record;
 }
 
 // read header
-void Vault::readHeader(std::ifstream &file) {
-  // read magic num
-  char magic[MAGIC_SIZE + 1] = {0};
-  file.read(magic, MAGIC_SIZE);
-  magic[MAGIC_SIZE] = '\0';
+void Vault::readHeader(const MappedFile &file) {
+  // whole header must be there before anything is trusted
+  file.span(0, HEADER_SIZE);
 
-  if (std::strncmp(magic, "OVLT", MAGIC_SIZE) != 0) {
+  // read magic num
+  std::span<const uint8_t> magic = file.span(0, MAGIC_SIZE);
+  if (std::memcmp(magic.data(), "OVLT", MAGIC_SIZE) != 0) {
     throw CorruptedVaultException("Invalid vault file format");
   }
+  size_t offset = MAGIC_SIZE;
 
   // read version
-  int version = 0;
-  file.read(reinterpret_cast<char*>(&version), sizeof(int));
-  if (version != 1) {
+  version = file.read<int>(offset);
+  offset += sizeof(int);
+  if (version < 1 || version > CURRENT_VERSION) {
     throw CustomException("Unsupported vault version: " + std::to_string(version));
   }
 
   // read salt, iters, hash
-  salt.resize(SALT_SIZE);
-  file.read(reinterpret_cast<char*>(salt.data()), SALT_SIZE);
-  file.read(reinterpret_cast<char*>(&iterations), sizeof(int));
-  std::vector<uint8_t> hash(HASH_SIZE);
-  file.read(reinterpret_cast<char*>(hash.data()), HASH_SIZE);
-  master_password_hash = Utils::bytesToString(hash);
-
-  // skip padding
-  int read = MAGIC_SIZE + sizeof(int) + SALT_SIZE + sizeof(int) + HASH_SIZE;
-  int skip = HEADER_SIZE - read;
-  file.seekg(skip, std::ios::cur);
+  std::span<const uint8_t> saltBytes = file.span(offset, SALT_SIZE);
+  salt.assign(saltBytes.begin(), saltBytes.end());
+  offset += SALT_SIZE;
+  iterations = file.read<int>(offset);
+  offset += sizeof(int);
+  std::span<const uint8_t> hash = file.span(offset, HASH_SIZE);
+  master_password_hash = std::string(hash.begin(), hash.end());
+  offset += HASH_SIZE;
+
+  // read wrapped data key and flags
+  if (version >= 2) {
+    std::span<const uint8_t> wrapped = file.span(offset, WRAPPED_KEY_SIZE);
+    wrapped_key.assign(wrapped.begin(), wrapped.end());
+    offset += WRAPPED_KEY_SIZE;
+    flags = file.read<int>(offset);
+    offset += sizeof(int);
+    tableOffset = file.read<int64_t>(offset);
+    offset += sizeof(int64_t);
+
+    // cipher, vaults from before the field was added read 0 (CBC)
+    int mode = file.read<int>(offset);
+    if (mode != static_cast<int>(CipherMode::CBC) && mode != static_cast<int>(CipherMode::GCM)) {
+      throw CustomException("Unsupported vault cipher: " + std::to_string(mode));
+    }
+    fileMode = static_cast<CipherMode>(mode);
+  }
+  else {
+    flags = 0;
+    tableOffset = 0;
+    fileMode = CipherMode::CBC;
+  }
 }
 
-// save
+// save, refused while a batch holds uncommitted changes
 void Vault::save()
 {
   if (!isOpen) {
     throw CustomException("Vault is not open");
   }
+  if (inBatch) {
+    throw CustomException("Commit or roll back the batch first");
+  }
+
+  writeSnapshot();
+}
+
+// write the whole vault to a temp file and swap it in
+void Vault::writeSnapshot()
+{
 
   // temp
   std::string tempFile = filename + ".tmp";
@@ -231,80 +408,712 @@ void Vault::save()
     throw FileException("Cannot write to vault file");
   }
 
+  // v1 vault moves to a wrapped data key on its next full write
+  // until then encryption_key is the password derived key
+  bool upgrading = (version == 1);
+  // sealed secrets are re-encrypted when the key or the cipher changes
+  bool resealing = upgrading || fileMode != cipherMode;
+  CipherMode oldMode = fileMode;
+  int oldFlags = flags;
+  int64_t oldTableOffset = tableOffset;
+  SecureBytes kek;
+  std::map<int, SealedSecrets> resealed;
+
   try {
+    if (upgrading) {
+      kek = encryption_key;
+      generateWrappedKey(kek);
+      version = CURRENT_VERSION;
+    }
+
+    // secrets were sealed under the old key or cipher
+    if (resealing) {
+      const SecureBytes &oldKey = upgrading ? kek : encryption_key;
+      SecureBytes plain;
+      for (const auto &pair : secrets) {
+        AssociatedData aad = associatedData(ROLE_SECRETS, pair.first);
+        plain.resize(CryptoManager::maxDecryptedSize(pair.second.data.size(), oldMode));
+        size_t length = (*cryptography).decrypt(pair.second.data, oldKey, pair.second.iv, plain, oldMode, aad);
+        SealedSecrets sealed;
+        sealed.iv = (*cryptography).generateIV();
+        sealed.data = (*cryptography).encrypt(std::span<const uint8_t>(plain).first(length), encryption_key, sealed.iv, cipherMode, aad);
+        resealed[pair.first] = std::move(sealed);
+      }
+      (*cryptography).wipe(plain.data(), plain.size());
+    }
+    fileMode = cipherMode;
+
+    // table offset is filled in once the entries are out
+    flags = FLAG_SPLIT_RECORDS | FLAG_OFFSET_TABLE;
+    tableOffset = 0;
+
     writeHeader(file);
 
     // write count
-    int count = entries.size();
+    int count = columns.size();
     std::vector<uint8_t> countBytes(sizeof(int));
     std::memcpy(countBytes.data(), &count, sizeof(int));
 
     auto iv = (*cryptography).generateIV();
-    auto encrypted = (*cryptography).encrypt(countBytes, encryption_key, iv);
+    auto encrypted = (*cryptography).encrypt(countBytes, encryption_key, iv, fileMode, associatedData(ROLE_COUNT, 0));
 
     // write iv, size count, count
     file.write(reinterpret_cast<const char*>(iv.data()), iv.size());
     int encryptedSize = encrypted.size();
     file.write(reinterpret_cast<const char*>(&encryptedSize), sizeof(int));
     file.write(reinterpret_cast<const char*>(encrypted.data()), encrypted.size());
+    int64_t position = HEADER_SIZE + iv.size() + sizeof(int) + encrypted.size();
+
+    // write every entry: index record, then its secrets record
+    // workers encrypt chunks of entries into buffers while this thread
+    // writes finished chunks out in id order
+    const std::map<int, SealedSecrets> &sealedSecrets = resealing ? resealed : secrets;
+    std::vector<int> ordered = columns.allIds();
+
+    size_t chunks = (ordered.size() + SAVE_CHUNK_ENTRIES - 1) / SAVE_CHUNK_ENTRIES;
+    std::vector<std::vector<char>> buffers(chunks);
+    std::vector<bool> ready(chunks, false);
+    // file offset of each index record, relative to its chunk until written
+    std::vector<int64_t> recordOffsets(ordered.size());
+    bool failed = false;
+    std::mutex lock;
+    std::condition_variable chunkReady;
+
+    std::thread writer([&]() {
+      for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        std::vector<char> buffer;
+        {
+          std::unique_lock<std::mutex> guard(lock);
+          chunkReady.wait(guard, [&]() { return ready[chunk] || failed; });
+          if (failed) {
+            return;
+          }
+          buffer.swap(buffers[chunk]);
+        }
+        size_t first = chunk * SAVE_CHUNK_ENTRIES;
+        size_t last = std::min(first + SAVE_CHUNK_ENTRIES, ordered.size());
+        for (size_t i = first; i < last; ++i) {
+          recordOffsets[i] += position;
+        }
+        file.write(buffer.data(), buffer.size());
+        position += buffer.size();
+      }
+    });
+
+    try {
+      Utils::parallelFor(chunks, getThreads(), [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; ++chunk) {
+          size_t first = chunk * SAVE_CHUNK_ENTRIES;
+          size_t last = std::min(first + SAVE_CHUNK_ENTRIES, ordered.size());
+
+          // size the chunk buffer exactly, then encrypt straight into it
+          const size_t IV_SIZE = 16;
+          std::vector<std::string> serialized;
+          serialized.reserve(last - first);
+          size_t bytes = 0;
+          for (size_t i = first; i < last; ++i) {
+            serialized.push_back(columns.entry(ordered[i]).serializeIndex());
+            bytes += 2 * (IV_SIZE + sizeof(int)) + CryptoManager::encryptedSize(serialized.back().size(), fileMode)
+                     + sealedSecrets.at(ordered[i]).data.size();
+          }
+
+          std::vector<char> buffer(bytes);
+          uint8_t *out = reinterpret_cast<uint8_t*>(buffer.data());
+          size_t used = 0;
+          for (size_t i = first; i < last; ++i) {
+            // index record: iv, size, ciphertext
+            const std::string &index = serialized[i - first];
+            std::span<uint8_t> entryIv(out + used, IV_SIZE);
+            (*cryptography).generateIV(entryIv);
+            int size = CryptoManager::encryptedSize(index.size(), fileMode);
+            std::memcpy(out + used + IV_SIZE, &size, sizeof(int));
+            std::span<const uint8_t> entryBytes(reinterpret_cast<const uint8_t*>(index.data()), index.size());
+            (*cryptography).encrypt(entryBytes, encryption_key, entryIv, std::span<uint8_t>(out + used + IV_SIZE + sizeof(int), size), fileMode, associatedData(ROLE_INDEX, i));
+            recordOffsets[i] = used;
+            used += IV_SIZE + sizeof(int) + size;
+
+            // secrets are already encrypted, copy them through
+            const SealedSecrets &sealed = sealedSecrets.at(ordered[i]);
+            size = sealed.data.size();
+            std::memcpy(out + used, sealed.iv.data(), IV_SIZE);
+            std::memcpy(out + used + IV_SIZE, &size, sizeof(int));
+            std::memcpy(out + used + IV_SIZE + sizeof(int), sealed.data.data(), size);
+            used += IV_SIZE + sizeof(int) + size;
+          }
+
+          std::lock_guard<std::mutex> guard(lock);
+          buffers[chunk].swap(buffer);
+          ready[chunk] = true;
+          chunkReady.notify_all();
+        }
+      }, 1);
+    }
+    catch (...) {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        failed = true;
+      }
+      chunkReady.notify_all();
+      writer.join();
+      throw;
+    }
+    writer.join();
+
+    // offset table: (id, offset) pairs in id order, one record after the entries
+    std::vector<uint8_t> table(ordered.size() * OFFSET_TABLE_ENTRY_SIZE);
+    for (size_t i = 0; i < ordered.size(); ++i) {
+      int id = ordered[i];
+      std::memcpy(table.data() + i * OFFSET_TABLE_ENTRY_SIZE, &id, sizeof(int));
+      std::memcpy(table.data() + i * OFFSET_TABLE_ENTRY_SIZE + sizeof(int), &recordOffsets[i], sizeof(int64_t));
+    }
+    if (table.empty()) {
+      // encrypted record is never empty, keep a placeholder id 0
+      table.resize(OFFSET_TABLE_ENTRY_SIZE, 0);
+    }
+    iv = (*cryptography).generateIV();
+    encrypted = (*cryptography).encrypt(table, encryption_key, iv, fileMode, associatedData(ROLE_TABLE, 0));
+    encryptedSize = encrypted.size();
+    file.write(reinterpret_cast<const char*>(iv.data()), iv.size());
+    file.write(reinterpret_cast<const char*>(&encryptedSize), sizeof(int));
+    file.write(reinterpret_cast<const char*>(encrypted.data()), encrypted.size());
 
-    // write every entry
-    for (const auto &pair : entries) {
-      const PasswordEntry &entry = pair.second;
-      std::string serialized = entry.serialize();
-      std::vector<uint8_t> entryBytes = Utils::stringToBytes(serialized);
+    // point header at the table
+    tableOffset = position;
+    file.seekp(0);
+    writeHeader(file);
 
-      // encrypt
-      iv = (*cryptography).generateIV();
-      encrypted = (*cryptography).encrypt(entryBytes, encryption_key, iv);
+    file.flush();
+    if (!file) {
+      throw FileException("Cannot write to vault file");
+    }
+    file.close();
 
-      // write iv,size,entry
-      int size = encrypted.size();
-      file.write(reinterpret_cast<const char*>(iv.data()), iv.size());
-      file.write(reinterpret_cast<const char*>(&size), sizeof(int));
-      file.write(reinterpret_cast<const char*>(encrypted.data()), size);
+    // temp on disk before it replaces the old vault, rename swaps them in one step
+    if (!syncPath(tempFile, O_RDONLY) || std::rename(tempFile.c_str(), filename.c_str()) != 0) {
+      throw FileException("Cannot write to vault file");
     }
+    // best effort, the new vault is already in place
+    syncPath(directoryOf(filename), O_RDONLY | O_DIRECTORY);
 
-    file.close();
+    if (resealing) {
+      secrets = std::move(resealed);
+    }
 
-    // swap temp with old, remove old
-    std::remove(filename.c_str());
-    std::rename(tempFile.c_str(), filename.c_str());
+    // snapshot now holds everything the journal did
+    std::remove(journalFilename().c_str());
+    journalBytes = 0;
+    snapshotBytes = std::filesystem::file_size(filename);
+    ++writeCount;
   }
   catch (...) {
     file.close();
     std::remove(tempFile.c_str());
+    flags = oldFlags;
+    tableOffset = oldTableOffset;
+    fileMode = oldMode;
+    if (upgrading) {
+      wipeKey();
+      encryption_key = kek;
+      wrapped_key.clear();
+      version = 1;
+    }
+    (*cryptography).wipe(kek.data(), kek.size());
+    CryptoManager::releaseCachedKeys();
     throw;
   }
+  // an upgrade decrypted with kek, its schedule may still be cached
+  (*cryptography).wipe(kek.data(), kek.size());
+  CryptoManager::releaseCachedKeys();
+}
+
+// compact
+void Vault::compact() {
+  save();
+}
+
+// change master password
+// v2 only rewrites the header: new salt, hash and wrapped data key
+void Vault::changeMasterPassword(std::string_view newPassword) {
+  if (!isOpen) {
+    throw CustomException("Vault is not open");
+  }
+
+  if (inBatch) {
+    throw CustomException("Commit or roll back the batch first");
+  }
+
+  // v1 has no data key yet, one full write upgrades it
+  if (version == 1) {
+    save();
+  }
+
+  std::vector<uint8_t> oldSalt = salt;
+  std::vector<uint8_t> oldWrapped = wrapped_key;
+  std::string oldHash = master_password_hash;
+
+  salt = (*cryptography).generateSalt();
+  SecureBytes kek = (*cryptography).deriveKey(newPassword, salt);
+  wrapped_key = (*cryptography).wrapKey(encryption_key, kek);
+  (*cryptography).wipe(kek.data(), kek.size());
+  master_password_hash = Utils::bytesToString(hashPassword(newPassword));
+
+  // build whole header first so it goes out in one write
+  std::ostringstream header;
+  writeHeader(header);
+  std::string bytes = header.str();
+
+  // header is HEADER_SIZE bytes at offset 0, one pwrite within a single sector
+  int fd = ::open(filename.c_str(), O_WRONLY);
+  bool written = false;
+  if (fd >= 0) {
+    written = pwrite(fd, bytes.data(), bytes.size(), 0) == static_cast<ssize_t>(bytes.size()) && fsync(fd) == 0;
+    written = (::close(fd) == 0) && written;
+  }
+  if (!written) {
+    salt = oldSalt;
+    wrapped_key = oldWrapped;
+    master_password_hash = oldHash;
+    throw FileException("Cannot write to vault file");
+  }
+}
+
+// journal file name
+std::string Vault::journalFilename() const {
+  return filename + ".journal";
+}
+
+// encrypt one record (op + payload) for the journal
+// record layout matches the snapshot: iv, size, encrypted
+std::vector<char> Vault::sealJournalRecord(char op, std::string_view payload, long offset) {
+  SecureBytes plain(1 + payload.size());
+  plain[0] = op;
+  std::memcpy(plain.data() + 1, payload.data(), payload.size());
+  auto iv = (*cryptography).generateIV();
+  auto encrypted = (*cryptography).encrypt(plain, encryption_key, iv, fileMode, associatedData(ROLE_JOURNAL, offset));
+  (*cryptography).wipe(plain.data(), plain.size());
+
+  int size = encrypted.size();
+  std::vector<char> record(iv.size() + sizeof(int) + size);
+  std::memcpy(record.data(), iv.data(), iv.size());
+  std::memcpy(record.data() + iv.size(), &size, sizeof(int));
+  std::memcpy(record.data() + iv.size() + sizeof(int), encrypted.data(), size);
+  return record;
+}
+
+// append records to the journal
+void Vault::writeJournal(const std::vector<char> &records) {
+  std::ofstream file(journalFilename(), std::ios::binary | std::ios::app);
+  if (!file) {
+    throw FileException("Cannot write to journal file");
+  }
+
+  // one write per call so a crash leaves at most a torn tail
+  file.write(records.data(), records.size());
+  file.flush();
+  if (!file) {
+    throw FileException("Cannot write to journal file");
+  }
+  journalBytes += records.size();
+  ++writeCount;
+}
+
+// compact once journal is big in absolute terms and relative to snapshot
+bool Vault::journalNeedsCompaction(long pendingBytes) const {
+  long total = journalBytes + pendingBytes;
+  return total >= JOURNAL_COMPACT_MIN_BYTES && total >= snapshotBytes / 2;
+}
+
+// encrypt password and notes
+Vault::SealedSecrets Vault::sealSecrets(const PasswordEntry &entry) const {
+  SecureString plain = entry.serializeSecrets();
+  std::span<const uint8_t> bytes(reinterpret_cast<const uint8_t*>(plain.data()), plain.size());
+
+  SealedSecrets sealed;
+  sealed.iv = (*cryptography).generateIV();
+  sealed.data = (*cryptography).encrypt(bytes, encryption_key, sealed.iv, fileMode, associatedData(ROLE_SECRETS, entry.getId()));
+  (*cryptography).wipe(plain.data(), plain.size());
+  return sealed;
+}
+
+// keep index in memory, seal password and notes
+void Vault::storeEntry(const PasswordEntry &entry) {
+  secrets[entry.getId()] = sealSecrets(entry);
+  columns.put(entry);
+}
+
+// forget an entry in every in-memory structure
+void Vault::dropEntry(int id) {
+  secrets.erase(id);
+  columns.remove(id);
+}
+
+// decrypt secrets into a copy of the index entry
+PasswordEntry Vault::unseal(const PasswordEntry &index) const {
+  auto sealed_found = secrets.find(index.getId());
+  if (sealed_found == secrets.end()) {
+    throw CorruptedVaultException("Missing secrets for entry: " + std::to_string(index.getId()));
+  }
+
+  PasswordEntry entry = index;
+  try {
+    const SealedSecrets &sealed = (*sealed_found).second;
+    SecureBytes decrypted(CryptoManager::maxDecryptedSize(sealed.data.size(), fileMode));
+    size_t length = (*cryptography).decrypt(sealed.data, encryption_key, sealed.iv, decrypted, fileMode, associatedData(ROLE_SECRETS, index.getId()));
+    entry.loadSecrets(std::string_view(reinterpret_cast<const char*>(decrypted.data()), length));
+    (*cryptography).wipe(decrypted.data(), decrypted.size());
+  }
+  catch (const std::runtime_error &e) {
+    throw CorruptedVaultException("Failed to decrypt entry: " + std::to_string(index.getId()));
+  }
+  return entry;
+}
+
+// decrypt journal records one by one
+// stops at the first incomplete record (torn tail)
+long Vault::readJournal(const std::function<void(char, std::string_view)> &apply) {
+  std::ifstream file(journalFilename(), std::ios::binary);
+  if (!file) {
+    return 0;
+  }
+
+  std::vector<uint8_t> iv(16);
+  SecureBytes record;
+  long good = 0;
+
+  while (true) {
+    int size = 0;
+    file.read(reinterpret_cast<char*>(iv.data()), iv.size());
+    file.read(reinterpret_cast<char*>(&size), sizeof(int));
+    if (!file || size <= 0) {
+      break;
+    }
+    std::vector<uint8_t> encrypted(size);
+    file.read(reinterpret_cast<char*>(encrypted.data()), size);
+    if (!file) {
+      break;
+    }
+
+    // entries in the journal carry passwords, decrypt into locked memory
+    record.resize(CryptoManager::maxDecryptedSize(encrypted.size(), fileMode));
+    size_t length = (*cryptography).decrypt(encrypted, encryption_key, iv, record, fileMode, associatedData(ROLE_JOURNAL, good));
+    if (length == 0) {
+      throw CorruptedVaultException("Invalid journal record");
+    }
+
+    std::string_view view(reinterpret_cast<const char*>(record.data()), length);
+    apply(view[0], view.substr(1));
+    (*cryptography).wipe(record.data(), record.size());
+    good += iv.size() + sizeof(int) + size;
+  }
+  return good;
+}
+
+// replay journal records over the snapshot
+void Vault::replayJournal() {
+  journalBytes = 0;
+  if (!std::filesystem::exists(journalFilename())) {
+    return;
+  }
+
+  long good = readJournal([this](char op, std::string_view payload) {
+    // put replaces whole entry, delete drops id; both are idempotent
+    if (op == JOURNAL_PUT) {
+      PasswordEntry entry = PasswordEntry::deserialize(payload);
+      storeEntry(entry);
+      if (entry.getId() >= nextId) {
+        nextId = entry.getId() + 1;
+      }
+    }
+    else if (op == JOURNAL_DELETE) {
+      dropEntry(std::stoi(std::string(payload)));
+    }
+    else {
+      throw CorruptedVaultException("Invalid journal record");
+    }
+  });
+
+  // drop a torn tail left by an interrupted append
+  if (good != static_cast<long>(std::filesystem::file_size(journalFilename()))) {
+    std::filesystem::resize_file(journalFilename(), good);
+  }
+  journalBytes = good;
+}
+
+// persist one mutation, journaled or as a full snapshot
+void Vault::persist(char op, std::string_view payload) {
+  if (!journaling) {
+    writeSnapshot();
+    return;
+  }
+
+  writeJournal(sealJournalRecord(op, payload, journalBytes));
+  if (journalNeedsCompaction(0)) {
+    compact();
+  }
+}
+
+// save before-image on first touch in a batch
+void Vault::rememberForBatch(int id) {
+  if (!inBatch || undo.count(id)) {
+    return;
+  }
+
+  if (!columns.contains(id)) {
+    undo[id] = std::nullopt;
+  }
+  else {
+    undo[id] = unseal(columns.entry(id));
+  }
+}
+
+// begin batch
+void Vault::beginBatch() {
+  if (!isOpen) {
+    throw CustomException("Vault is not open");
+  }
+  if (inBatch) {
+    throw CustomException("Batch already in progress");
+  }
+
+  inBatch = true;
+  batchNextId = nextId;
+  undo.clear();
+}
+
+// commit batch with a single durable write
+void Vault::commit() {
+  if (!inBatch) {
+    throw CustomException("No batch in progress");
+  }
+
+  if (!undo.empty()) {
+    if (!journaling) {
+      writeSnapshot();
+    }
+    else {
+      // final state of every touched entry
+      std::vector<std::pair<char, SecureString>> records;
+      long estimate = 0;
+      for (const auto &touched : undo) {
+        if (columns.contains(touched.first)) {
+          records.emplace_back(JOURNAL_PUT, unseal(columns.entry(touched.first)).serialize());
+        }
+        else if (touched.second.has_value()) {
+          records.emplace_back(JOURNAL_DELETE, SecureString(std::to_string(touched.first)));
+        }
+        else {
+          // added and deleted inside batch, nothing to write
+          continue;
+        }
+        // iv + size + op + padded ciphertext
+        estimate += 16 + sizeof(int) + (records.back().second.size() + 1) / 16 * 16 + 16;
+      }
+
+      // big batch goes straight to a snapshot instead of journal + compaction
+      if (journalNeedsCompaction(estimate)) {
+        writeSnapshot();
+      }
+      else if (!records.empty()) {
+        std::vector<char> sealed;
+        sealed.reserve(estimate);
+        for (const auto &record : records) {
+          std::vector<char> one = sealJournalRecord(record.first, record.second, journalBytes + sealed.size());
+          sealed.insert(sealed.end(), one.begin(), one.end());
+        }
+        writeJournal(sealed);
+      }
+    }
+  }
+
+  inBatch = false;
+  undo.clear();
+}
+
+// rollback batch, restoring before-images
+void Vault::rollback() {
+  if (!inBatch) {
+    throw CustomException("No batch in progress");
+  }
+
+  for (const auto &touched : undo) {
+    if (touched.second.has_value()) {
+      storeEntry(*touched.second);
+    }
+    else {
+      dropEntry(touched.first);
+    }
+  }
+  nextId = batchNextId;
+
+  inBatch = false;
+  undo.clear();
+}
+
+// transaction constructor, begins batch
+Vault::Transaction::Transaction(Vault &vault) : vault(vault), finished(false) {
+  vault.beginBatch();
+}
+
+// transaction destructor, rollback if not committed
+Vault::Transaction::~Transaction() {
+  if (!finished) {
+    try {
+      vault.rollback();
+    }
+    catch (...) {
+      // none
+    }
+  }
+}
+
+// commit transaction
+void Vault::Transaction::commit() {
+  vault.commit();
+  finished = true;
+}
+
+// rollback transaction
+void Vault::Transaction::rollback() {
+  finished = true;
+  vault.rollback();
 }
 
 // close
 void Vault::close() {
   if (isOpen) {
-    // wipe key
-    if (!encryption_key.empty()) {
-      (*cryptography).wipe(encryption_key.data(), encryption_key.size());
-      encryption_key.clear();
-    }
-    entries.clear();
+    wipeKey();
+    // uncommitted batch is discarded
+    secrets.clear();
+    columns.clear();
+    undo.clear();
+    inBatch = false;
     isOpen = false;
   }
 }
 
+// single entry lookup
+PasswordEntry Vault::lookup(std::string_view masterPassword, int id) {
+  if (isOpen) {
+    return getEntry(id);
+  }
+
+  std::optional<PasswordEntry> found;
+  bool hasTable = false;
+  {
+    MappedFile file(filename);
+    readHeader(file);
+    verifyPassword(masterPassword);
+    hasTable = (flags & FLAG_OFFSET_TABLE) && tableOffset > 0;
+
+    if (hasTable) {
+      unlockKey(masterPassword);
+      try {
+        // binary search the (id, offset) table
+        Record tableRecord = readRecord(file, tableOffset);
+        std::vector<uint8_t> table = (*cryptography).decrypt(tableRecord.data, encryption_key, tableRecord.iv, fileMode, associatedData(ROLE_TABLE, 0));
+        size_t count = table.size() / OFFSET_TABLE_ENTRY_SIZE;
+        auto idAt = [&table](size_t i) {
+          int tableId = 0;
+          std::memcpy(&tableId, table.data() + i * OFFSET_TABLE_ENTRY_SIZE, sizeof(int));
+          return tableId;
+        };
+        size_t low = 0;
+        size_t high = count;
+        while (low < high) {
+          size_t middle = low + (high - low) / 2;
+          if (idAt(middle) < id) {
+            low = middle + 1;
+          }
+          else {
+            high = middle;
+          }
+        }
+
+        if (low < count && idAt(low) == id) {
+          int64_t offset = 0;
+          std::memcpy(&offset, table.data() + low * OFFSET_TABLE_ENTRY_SIZE + sizeof(int), sizeof(int64_t));
+
+          // index record, then its secrets record
+          Record indexRecord = readRecord(file, offset);
+          auto decryptedIndex = (*cryptography).decrypt(indexRecord.data, encryption_key, indexRecord.iv, fileMode, associatedData(ROLE_INDEX, low));
+          PasswordEntry entry = PasswordEntry::deserializeIndex(std::string_view(reinterpret_cast<const char*>(decryptedIndex.data()), decryptedIndex.size()));
+          if (entry.getId() != id) {
+            throw CorruptedVaultException("Offset table does not match entry");
+          }
+
+          Record secretRecord = readRecord(file, indexRecord.end);
+          SecureBytes decryptedSecrets(CryptoManager::maxDecryptedSize(secretRecord.data.size(), fileMode));
+          size_t length = (*cryptography).decrypt(secretRecord.data, encryption_key, secretRecord.iv, decryptedSecrets, fileMode, associatedData(ROLE_SECRETS, id));
+          entry.loadSecrets(std::string_view(reinterpret_cast<const char*>(decryptedSecrets.data()), length));
+          (*cryptography).wipe(decryptedSecrets.data(), decryptedSecrets.size());
+          found = entry;
+        }
+
+        // later changes to this id, journal is left as is
+        readJournal([&found, id](char op, std::string_view payload) {
+          if (op == JOURNAL_PUT) {
+            PasswordEntry entry = PasswordEntry::deserialize(payload);
+            if (entry.getId() == id) {
+              found = entry;
+            }
+          }
+          else if (op == JOURNAL_DELETE && std::stoi(std::string(payload)) == id) {
+            found.reset();
+          }
+        });
+      }
+      catch (const CustomException &e) {
+        wipeKey();
+        throw;
+      }
+      catch (const std::exception &e) {
+        wipeKey();
+        throw CorruptedVaultException("Failed to decrypt vault data");
+      }
+      wipeKey();
+    }
+  }
+
+  // no table yet, read it the long way
+  if (!hasTable) {
+    open(masterPassword);
+    try {
+      found = getEntry(id);
+    }
+    catch (...) {
+      close();
+      throw;
+    }
+    close();
+  }
+
+  if (!found.has_value()) {
+    throw EntryException("Entry not found: " + std::to_string(id));
+  }
+  return *found;
+}
+
 // add entry 
 int Vault::addEntry(const PasswordEntry &entry) {
   if (!isOpen) {
     throw CustomException("Vault is not open");
   }
 
+  if (!entry.hasSecrets()) {
+    throw EntryException("Entry has no password loaded");
+  }
+
   PasswordEntry newEntry = entry;
   newEntry.setId(nextId);
 
-  entries[nextId] = newEntry;
+  rememberForBatch(nextId);
+  storeEntry(newEntry);
   ++nextId;
 
-  // save, return id num
-  save();
+  // persist, return id num
+  if (!inBatch) {
+    persist(JOURNAL_PUT, newEntry.serialize());
+  }
   return newEntry.getId();
 }
 
@@ -314,12 +1123,11 @@ PasswordEntry Vault::getEntry(int id) const {
     throw CustomException("Vault is not open");
   }
 
-  auto entry_found = entries.find(id);
-  if (entry_found == entries.end()) {
+  if (!columns.contains(id)) {
     throw EntryException("Entry not found: " + std::to_string(id));
   }
 
-  return (*entry_found).second;
+  return unseal(columns.entry(id));
 }
 
 // get every entry
@@ -329,26 +1137,71 @@ std::vector<PasswordEntry> Vault::getAllEntries() const {
   }
 
   std::vector<PasswordEntry> entries_v;
-  for (const auto &entry : entries) {
-    entries_v.push_back(entry.second);
+  entries_v.reserve(columns.size());
+  for (int id : columns.allIds()) {
+    entries_v.push_back(unseal(columns.entry(id)));
   }
 
   return entries_v;
 }
 
+// list every entry, index fields only
+std::vector<PasswordEntry> Vault::listEntries() const {
+  if (!isOpen) {
+    throw CustomException("Vault is not open");
+  }
+
+  std::vector<PasswordEntry> entries_v;
+  entries_v.reserve(columns.size());
+  for (int id : columns.allIds()) {
+    entries_v.push_back(columns.entry(id));
+  }
+
+  return entries_v;
+}
+
+// visit every entry, index fields only
+void Vault::forEachEntry(const EntryVisitor &visit) const {
+  if (!isOpen) {
+    throw CustomException("Vault is not open");
+  }
+
+  for (int id : columns.allIds()) {
+    visit(columns.entry(id));
+  }
+}
+
+// visit every entry in the order of the service index, no sorting per call
+void Vault::forEachByService(const EntryVisitor &visit) const {
+  if (!isOpen) {
+    throw CustomException("Vault is not open");
+  }
+
+  for (int id : columns.orderedByService()) {
+    visit(columns.entry(id));
+  }
+}
+
 // update an entry
 void Vault::updateEntry(const PasswordEntry &entry) {
   if (!isOpen) {
     throw CustomException("Vault is not open");
   }
 
-  auto entry_found = entries.find(entry.getId());
-  if (entry_found == entries.end()) {
+  if (!columns.contains(entry.getId())) {
     throw EntryException("Entry not found: " + std::to_string(entry.getId()));
   }
 
-  entries[entry.getId()] = entry;
-  save();
+  // index only copy would overwrite the stored password with nothing
+  if (!entry.hasSecrets()) {
+    throw EntryException("Entry has no password loaded, use getEntry()");
+  }
+
+  rememberForBatch(entry.getId());
+  storeEntry(entry);
+  if (!inBatch) {
+    persist(JOURNAL_PUT, entry.serialize());
+  }
 }
 
 // delete an entry
@@ -357,47 +1210,65 @@ void Vault::deleteEntry(int id) {
     throw CustomException("Vault is not open");
   }
 
-  auto entry_found = entries.find(id);
-  if (entry_found == entries.end()) {
+  if (!columns.contains(id)) {
     throw EntryException("Entry not found: " + std::to_string(id));
   }
 
-  entries.erase(entry_found);
-  save();
+  rememberForBatch(id);
+  dropEntry(id);
+  if (!inBatch) {
+    persist(JOURNAL_DELETE, std::to_string(id));
+  }
 }
 
-// search for entries by service
-std::vector<PasswordEntry> Vault::searchByService(const std::string &query) const {
+// entries matching every term of the expression
+std::vector<PasswordEntry> Vault::search(const std::string &expression) const {
+  std::vector<PasswordEntry> entry_found;
+  forEachMatch(expression, [&entry_found](const PasswordEntry &entry) {
+    entry_found.push_back(entry);
+  });
+  return entry_found;
+}
+
+// visit matches in place, the filter reads the columns and only matches touch the entries
+void Vault::forEachMatch(const std::string &expression, const EntryVisitor &visit) const {
   if (!isOpen) {
     throw CustomException("Vault is not open");
   }
 
-  std::vector<PasswordEntry> entry_found;
+  for (int id : columns.select(Query::parse(expression))) {
+    visit(columns.entry(id));
+  }
+}
 
-  for (const auto &entry : entries) {
-    if (entry.second.getService().find(query) != std::string::npos)
-    {
-      entry_found.push_back(entry.second);
-    }
+// stale entries for rotation reports, oldest first
+void Vault::forEachModifiedBefore(time_t cutoff, const EntryVisitor &visit) const {
+  if (!isOpen) {
+    throw CustomException("Vault is not open");
   }
 
-  return entry_found;
+  for (int id : columns.modifiedBetween(INT64_MIN, cutoff)) {
+    visit(columns.entry(id));
+  }
 }
 
-// search for entries by category
-std::vector<PasswordEntry> Vault::searchByCategory(const std::string &category) const {
+// best approximate matches on service or url, best first
+std::vector<PasswordEntry> Vault::fuzzySearch(const std::string &query, size_t limit) const {
   if (!isOpen) {
     throw CustomException("Vault is not open");
   }
 
   std::vector<PasswordEntry> entry_found;
-
-  for (const auto &entry : entries) {
-    if (entry.second.getCategory() == category)
-    {
-      entry_found.push_back(entry.second);
-    }
+  for (int id : columns.matchFuzzy(query, limit)) {
+    entry_found.push_back(columns.entry(id));
   }
-
   return entry_found;
 }
+
+// entries per category, "" for uncategorized
+std::map<std::string, int> Vault::countByCategory() const {
+  if (!isOpen) {
+    throw CustomException("Vault is not open");
+  }
+  return columns.countByCategory();
+}
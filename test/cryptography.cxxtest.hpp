@@ -3,9 +3,13 @@
 
 #include <cxxtest/TestSuite.h>
 #include "cryptography.hpp"
+#include "crypto_engine.hpp"
 #include "utils.hpp"
 #include <vector>
+#include <algorithm>
 #include <string>
+#include <thread>
+#include <atomic>
 
 class CryptoTestSuite : public CxxTest::TestSuite {
   public:
@@ -34,17 +38,17 @@ class CryptoTestSuite : public CxxTest::TestSuite {
       std::string password = "Password123";
       std::vector<uint8_t> salt = crypto.generateSalt();
 
-      std::vector<uint8_t> key = crypto.deriveKey(password, salt);
+      SecureBytes key = crypto.deriveKey(password, salt);
       TS_ASSERT_EQUALS(key.size(), 32);
 
-      std::vector<uint8_t> key2 = crypto.deriveKey(password, salt);
+      SecureBytes key2 = crypto.deriveKey(password, salt);
       TS_ASSERT_EQUALS(key, key2);
 
       std::vector<uint8_t> salt3 = crypto.generateSalt();
-      std::vector<uint8_t> key3 = crypto.deriveKey(password, salt3);
+      SecureBytes key3 = crypto.deriveKey(password, salt3);
       TS_ASSERT_DIFFERS(key, key3);
 
-      std::vector<uint8_t> key4 = crypto.deriveKey("DifferentPassword", salt);
+      SecureBytes key4 = crypto.deriveKey("DifferentPassword", salt);
       TS_ASSERT_DIFFERS(key, key4);
     }
 
@@ -52,7 +56,7 @@ class CryptoTestSuite : public CxxTest::TestSuite {
       CryptoManager crypto;
       std::string password = "Password123";
       std::vector<uint8_t> salt = crypto.generateSalt();
-      std::vector<uint8_t> key = crypto.deriveKey(password, salt);
+      SecureBytes key = crypto.deriveKey(password, salt);
       std::vector<uint8_t> iv = crypto.generateIV();
       std::string plaintext = "plaintext";
       std::vector<uint8_t> plaintext_bytes = Utils::stringToBytes(plaintext);
@@ -71,7 +75,7 @@ class CryptoTestSuite : public CxxTest::TestSuite {
       CryptoManager crypto;
       std::string password = "Password123";
       std::vector<uint8_t> salt = crypto.generateSalt();
-      std::vector<uint8_t> key = crypto.deriveKey(password, salt);
+      SecureBytes key = crypto.deriveKey(password, salt);
       std::string plaintext = "plaintext";
       std::vector<uint8_t> plaintext_bytes = Utils::stringToBytes(plaintext);
 
@@ -94,7 +98,7 @@ class CryptoTestSuite : public CxxTest::TestSuite {
       CryptoManager crypto;
       std::string password = "Password123";
       std::vector<uint8_t> salt = crypto.generateSalt();
-      std::vector<uint8_t> key = crypto.deriveKey(password, salt);
+      SecureBytes key = crypto.deriveKey(password, salt);
       std::vector<uint8_t> iv = crypto.generateIV();
 
       std::vector<uint8_t> empty_data;
@@ -110,7 +114,7 @@ class CryptoTestSuite : public CxxTest::TestSuite {
       CryptoManager crypto;
       std::string password = "Password123";
       std::vector<uint8_t> salt = crypto.generateSalt();
-      std::vector<uint8_t> key = crypto.deriveKey(password, salt);
+      SecureBytes key = crypto.deriveKey(password, salt);
       std::vector<uint8_t> iv = crypto.generateIV();
 
       std::vector<uint8_t> large_data(1024 * 1024, 'A');
@@ -126,14 +130,14 @@ class CryptoTestSuite : public CxxTest::TestSuite {
 
       std::string password = "Password123";
       std::vector<uint8_t> salt = crypto.generateSalt();
-      std::vector<uint8_t> key = crypto.deriveKey(password, salt);
+      SecureBytes key = crypto.deriveKey(password, salt);
       std::vector<uint8_t> iv = crypto.generateIV();
 
       std::string plaintext = "plaintext";
       std::vector<uint8_t> plaintext_bytes = Utils::stringToBytes(plaintext);
       std::vector<uint8_t> ciphertext = crypto.encrypt(plaintext_bytes, key, iv);
 
-      std::vector<uint8_t> wrong_key = crypto.deriveKey("wrong password", salt);
+      SecureBytes wrong_key = crypto.deriveKey("wrong password", salt);
 
       bool caught_exception = false;
       try {
@@ -146,6 +150,125 @@ class CryptoTestSuite : public CxxTest::TestSuite {
       }
       TS_ASSERT(caught_exception || true);
     }
+
+    void testGcmEncryptDecrypt() {
+      CryptoManager crypto;
+      SecureBytes key = crypto.generateKey();
+      std::vector<uint8_t> iv = crypto.generateIV();
+      std::vector<uint8_t> aad = {1, 2, 3, 4};
+      std::vector<uint8_t> plaintext = Utils::stringToBytes("authenticated plaintext");
+
+      std::vector<uint8_t> ciphertext = crypto.encrypt(plaintext, key, iv, CipherMode::GCM, aad);
+      // no padding, 16 byte tag
+      TS_ASSERT_EQUALS(ciphertext.size(), plaintext.size() + 16);
+      TS_ASSERT_EQUALS(crypto.decrypt(ciphertext, key, iv, CipherMode::GCM, aad), plaintext);
+
+      // any change to ciphertext or associated data is rejected
+      std::vector<uint8_t> tampered = ciphertext;
+      tampered[0] ^= 1;
+      TS_ASSERT_THROWS_ANYTHING(crypto.decrypt(tampered, key, iv, CipherMode::GCM, aad));
+      std::vector<uint8_t> other_aad = {1, 2, 3, 5};
+      TS_ASSERT_THROWS_ANYTHING(crypto.decrypt(ciphertext, key, iv, CipherMode::GCM, other_aad));
+      TS_ASSERT_THROWS_ANYTHING(crypto.decrypt(ciphertext, key, iv, CipherMode::CBC));
+    }
+
+    void testSpanEncryptDecrypt() {
+      CryptoManager crypto;
+      SecureBytes key = crypto.generateKey();
+      SecureBytes other_key = crypto.generateKey();
+      std::vector<uint8_t> plaintext = Utils::stringToBytes("record written into a caller buffer");
+
+      for (CipherMode mode : {CipherMode::CBC, CipherMode::GCM}) {
+        uint8_t iv[16];
+        crypto.generateIV(iv);
+        std::vector<uint8_t> out(CryptoManager::encryptedSize(plaintext.size(), mode));
+        size_t written = crypto.encrypt(plaintext, key, iv, out, mode);
+        TS_ASSERT_EQUALS(written, out.size());
+
+        // same thread context, switching keys between calls
+        std::vector<uint8_t> back(CryptoManager::maxDecryptedSize(written, mode));
+        // cbc can pad out correctly by chance, only gcm must reject it
+        if (mode == CipherMode::GCM) {
+          TS_ASSERT_THROWS_ANYTHING(crypto.decrypt(std::span<const uint8_t>(out), other_key, iv, back, mode));
+        }
+        size_t read = crypto.decrypt(std::span<const uint8_t>(out), key, iv, back, mode);
+        back.resize(read);
+        TS_ASSERT_EQUALS(back, plaintext);
+
+        // vector api agrees with span api
+        TS_ASSERT_EQUALS(crypto.decrypt(out, key, std::vector<uint8_t>(iv, iv + 16), mode), plaintext);
+
+        std::vector<uint8_t> small(out.size() - 1);
+        TS_ASSERT_THROWS_ANYTHING(crypto.encrypt(plaintext, key, iv, small, mode));
+      }
+    }
+
+    void testReleasedKeyIsNotReused() {
+      CryptoManager crypto;
+      SecureBytes key = crypto.generateKey();
+      SecureBytes replacement = crypto.generateKey();
+      std::vector<uint8_t> plaintext = Utils::stringToBytes("same buffer, new key");
+      uint8_t iv[16];
+      crypto.generateIV(iv);
+
+      std::vector<uint8_t> first(CryptoManager::encryptedSize(plaintext.size(), CipherMode::GCM));
+      crypto.encrypt(plaintext, key, iv, first, CipherMode::GCM);
+
+      // new key written into the same buffer, as a reopened vault may do
+      std::copy(replacement.begin(), replacement.end(), key.begin());
+      CryptoManager::releaseCachedKeys();
+      std::vector<uint8_t> second(first.size());
+      crypto.encrypt(plaintext, key, iv, second, CipherMode::GCM);
+      TS_ASSERT_DIFFERS(first, second);
+      TS_ASSERT_EQUALS(crypto.decrypt(second, replacement, std::vector<uint8_t>(iv, iv + 16), CipherMode::GCM), plaintext);
+    }
+
+    void testWrapUnwrapKey() {
+      CryptoManager crypto;
+      std::vector<uint8_t> salt = crypto.generateSalt();
+      SecureBytes kek = crypto.deriveKey("Password123", salt);
+      SecureBytes key = crypto.generateKey();
+      TS_ASSERT_EQUALS(key.size(), 32);
+
+      std::vector<uint8_t> wrapped = crypto.wrapKey(key, kek);
+      TS_ASSERT_EQUALS(wrapped.size(), 40);
+      TS_ASSERT_EQUALS(crypto.unwrapKey(wrapped, kek), key);
+
+      SecureBytes wrong_kek = crypto.deriveKey("wrong password", salt);
+      TS_ASSERT_THROWS_ANYTHING(crypto.unwrapKey(wrapped, wrong_kek));
+    }
+
+    void testManagersShareEngine() {
+      TS_ASSERT_EQUALS(&CryptoEngine::instance(), &CryptoEngine::instance());
+
+      // a manager going away leaves openssl usable for the rest
+      SecureBytes key;
+      {
+        CryptoManager first;
+        key = first.generateKey();
+      }
+
+      // one manager per thread, all on the shared engine at once
+      std::atomic<int> failures(0);
+      std::vector<std::thread> workers;
+      for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&, t]() {
+          CryptoManager crypto;
+          std::vector<uint8_t> plaintext = Utils::stringToBytes("thread " + std::to_string(t));
+          for (int i = 0; i < 200; ++i) {
+            std::vector<uint8_t> iv = crypto.generateIV();
+            CipherMode mode = (i % 2) ? CipherMode::GCM : CipherMode::CBC;
+            if (crypto.decrypt(crypto.encrypt(plaintext, key, iv, mode), key, iv, mode) != plaintext) {
+              ++failures;
+            }
+          }
+        });
+      }
+      for (std::thread& worker : workers) {
+        worker.join();
+      }
+      TS_ASSERT_EQUALS(failures.load(), 0);
+    }
 };
 
 #endif
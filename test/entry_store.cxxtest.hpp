@@ -0,0 +1,230 @@
+#ifndef ENTRY_STORE_CXXTEST_HPP
+#define ENTRY_STORE_CXXTEST_HPP
+
+#include <cxxtest/TestSuite.h>
+#include "entry_store.hpp"
+#include <string>
+#include <cstdint>
+#include <thread>
+
+class EntryStoreTestSuite : public CxxTest::TestSuite {
+  private:
+    PasswordEntry make(int id, const std::string& service, const std::string& username, const std::string& category) {
+      PasswordEntry entry(id, service, username, "password");
+      entry.setCategory(category);
+      return entry;
+    }
+
+    // text record, the only way to set both times
+    PasswordEntry aged(int id, const std::string& service, int64_t createdAt, int64_t modifiedAt) {
+      return PasswordEntry::deserialize(std::to_string(id) + "|" + service + "|user|password|||cat|" +
+                                        std::to_string(createdAt) + "|" + std::to_string(modifiedAt));
+    }
+
+    std::vector<int> select(const EntryStore& store, const std::string& expression) {
+      return store.select(Query::parse(expression));
+    }
+
+  public:
+    void testMatchesComeBackInIdOrder() {
+      EntryStore store;
+      store.put(make(3, "GitHub", "alice", "Work"));
+      store.put(make(1, "Gmail", "bob", "Personal"));
+      store.put(make(2, "GitLab", "carol", "work"));
+      TS_ASSERT_EQUALS(store.size(), 3u);
+
+      TS_ASSERT_EQUALS(select(store, "service~Git"), std::vector<int>({2, 3}));
+      // below three bytes there is no trigram to look up, the columns are scanned
+      TS_ASSERT_EQUALS(select(store, "service~gi"), std::vector<int>({2, 3}));
+      TS_ASSERT(select(store, "service~bob").empty());
+
+      // equality ignores case too
+      TS_ASSERT_EQUALS(select(store, "category:WORK"), std::vector<int>({2, 3}));
+      TS_ASSERT_EQUALS(select(store, "category:wor").size(), 0u);
+      TS_ASSERT_EQUALS(select(store, "category~wo"), std::vector<int>({2, 3}));
+      TS_ASSERT(select(store, "category:Missing").empty());
+      TS_ASSERT_EQUALS(select(store, "service:gitlab"), std::vector<int>({2}));
+
+      // category, service or username, any case
+      TS_ASSERT_EQUALS(select(store, "WORK"), std::vector<int>({2, 3}));
+      TS_ASSERT_EQUALS(select(store, "BoB"), std::vector<int>({1}));
+      TS_ASSERT_EQUALS(select(store, "").size(), 3u);
+
+      // every clause has to hold
+      TS_ASSERT_EQUALS(select(store, "category:work user~carol"), std::vector<int>({2}));
+      TS_ASSERT(select(store, "category:work gmail").empty());
+    }
+
+    void testNumericClauses() {
+      EntryStore store;
+      PasswordEntry weak(1, "weak", "user", "abc");
+      PasswordEntry strong(2, "strong", "user", "x9$Kq!2vLp#7Zr@m");
+      strong.setCategory("work");
+      store.put(weak);
+      store.put(strong);
+      int bound = strong.getStrength();
+      TS_ASSERT(weak.getStrength() < bound);
+
+      TS_ASSERT_EQUALS(select(store, "strength<" + std::to_string(bound)), std::vector<int>({1}));
+      TS_ASSERT_EQUALS(select(store, "strength>=" + std::to_string(bound)), std::vector<int>({2}));
+      TS_ASSERT_EQUALS(select(store, "strength=" + std::to_string(bound)), std::vector<int>({2}));
+
+      // both were just created: younger than an hour, older than 2001
+      TS_ASSERT_EQUALS(select(store, "modified<1h"), std::vector<int>({1, 2}));
+      TS_ASSERT(select(store, "modified>1h").empty());
+      TS_ASSERT_EQUALS(select(store, "created>2001-01-01 category:work user~USER"), std::vector<int>({2}));
+
+      // ages are measured from the given now
+      time_t later = time(nullptr) + 30 * 86400;
+      TS_ASSERT(store.select(Query::parse("modified<1w", later)).empty());
+      TS_ASSERT_EQUALS(store.select(Query::parse("modified>=4w strength<" + std::to_string(bound), later)), std::vector<int>({1}));
+    }
+
+    void testTimeOrder() {
+      EntryStore store;
+      store.put(aged(1, "a", 100, 500));
+      store.put(aged(2, "b", 200, 300));
+      store.put(aged(3, "c", 300, 300));
+      store.put(aged(4, "d", 400, 900));
+      TS_ASSERT_EQUALS(store.modifiedBetween(INT64_MIN, 600), std::vector<int>({2, 3, 1}));
+      TS_ASSERT_EQUALS(store.modifiedBetween(300, 301), std::vector<int>({2, 3}));
+      TS_ASSERT(store.modifiedBetween(600, 600).empty());
+
+      // edits, new entries and removals keep the order without a resort
+      store.put(aged(2, "b", 200, 1000));
+      store.put(aged(5, "e", 50, 50));
+      store.remove(3);
+      TS_ASSERT_EQUALS(store.modifiedBetween(INT64_MIN, INT64_MAX), std::vector<int>({5, 1, 4, 2}));
+
+      // narrow time clauses take their candidates from the index, wide ones scan, both in id order
+      for (int id = 10; id < 50; ++id) {
+        store.put(aged(id, "f" + std::to_string(id), 2000 + id, 2000 + id));
+      }
+      const time_t day = 86400;
+      TS_ASSERT_EQUALS(store.select(Query::parse("modified<1d", 950 + day)).size(), 41u);
+      TS_ASSERT_EQUALS(store.select(Query::parse("modified>1d", 950 + day)), std::vector<int>({1, 4, 5}));
+      TS_ASSERT_EQUALS(store.select(Query::parse("created>1d", 250 + day)), std::vector<int>({1, 2, 5}));
+      TS_ASSERT_EQUALS(store.select(Query::parse("created>1d modified>1d service~d", 950 + day)), std::vector<int>({4}));
+      TS_ASSERT(store.select(Query::parse("created<1d modified>1d", 450 + day)).empty());
+
+      store.clear();
+      store.put(aged(7, "g", 10, 10));
+      TS_ASSERT_EQUALS(store.modifiedBetween(INT64_MIN, INT64_MAX), std::vector<int>({7}));
+    }
+
+    void testReplaceAndRemove() {
+      EntryStore store;
+      for (int id = 1; id <= 5; ++id) {
+        store.put(make(id, "service" + std::to_string(id), "user", id % 2 ? "odd" : "even"));
+      }
+
+      // longer and shorter values both replace the old ones
+      store.put(make(2, "a much longer service name", "user", "odd"));
+      store.put(make(4, "s4", "user", "odd"));
+      TS_ASSERT_EQUALS(select(store, "service~longer"), std::vector<int>({2}));
+      TS_ASSERT(select(store, "service~service4").empty());
+      TS_ASSERT_EQUALS(select(store, "category:odd").size(), 5u);
+
+      // last slot moves into the hole, lookups still find it
+      store.remove(1);
+      store.remove(42);
+      TS_ASSERT_EQUALS(store.size(), 4u);
+      TS_ASSERT(select(store, "service~service1").empty());
+      TS_ASSERT_EQUALS(select(store, "service~service5"), std::vector<int>({5}));
+      store.remove(5);
+      store.put(make(5, "back", "user", ""));
+      TS_ASSERT_EQUALS(select(store, "service:back"), std::vector<int>({5}));
+
+      std::map<std::string, int> counts = store.countByCategory();
+      TS_ASSERT_EQUALS(counts.size(), 2u);
+      TS_ASSERT_EQUALS(counts["odd"], 3);
+      TS_ASSERT_EQUALS(counts[""], 1);
+
+      store.clear();
+      TS_ASSERT_EQUALS(store.size(), 0u);
+      TS_ASSERT(select(store, "").empty());
+    }
+
+    void testServiceOrderAndCategoryIndex() {
+      EntryStore store;
+      store.put(make(1, "Gmail", "a", "Mail"));
+      store.put(make(2, "AWS", "b", "Work"));
+      store.put(make(3, "GitHub", "c", "Work"));
+      TS_ASSERT_EQUALS(store.orderedByService(), std::vector<int>({2, 3, 1}));
+
+      // renames and new entries are placed without a resort, equal names go by id
+      store.put(make(2, "Zoom", "b", "Work"));
+      store.put(make(4, "GitHub", "d", "Mail"));
+      store.put(make(0, "GitHub", "e", "Mail"));
+      TS_ASSERT_EQUALS(store.orderedByService(), std::vector<int>({0, 3, 4, 1, 2}));
+      store.remove(3);
+      TS_ASSERT_EQUALS(store.orderedByService(), std::vector<int>({0, 4, 1, 2}));
+
+      // moving between categories updates both member lists and the counts
+      TS_ASSERT_EQUALS(select(store, "category:Mail"), std::vector<int>({0, 1, 4}));
+      store.put(make(1, "Gmail", "a", "Work"));
+      TS_ASSERT_EQUALS(select(store, "category:Mail"), std::vector<int>({0, 4}));
+      TS_ASSERT_EQUALS(select(store, "category:Work"), std::vector<int>({1, 2}));
+      store.remove(2);
+      std::map<std::string, int> counts = store.countByCategory();
+      TS_ASSERT_EQUALS(counts["Mail"], 2);
+      TS_ASSERT_EQUALS(counts["Work"], 1);
+
+      store.clear();
+      TS_ASSERT(store.orderedByService().empty());
+      TS_ASSERT(store.countByCategory().empty());
+    }
+
+    void testManyUpdatesAndLargeIds() {
+      EntryStore store;
+      // enough rewrites that the string columns get packed
+      for (int round = 0; round < 200; ++round) {
+        for (int id = 1; id <= 50; ++id) {
+          store.put(make(id, "service-" + std::to_string(id) + "-" + std::string(round % 7 * 10, 'x'), "user", "cat"));
+        }
+      }
+      TS_ASSERT_EQUALS(store.size(), 50u);
+      TS_ASSERT_EQUALS(select(store, "service~service-17-").size(), 1u);
+
+      // ids beyond the flat table
+      store.put(make(2000000000, "far", "user", "cat"));
+      store.put(make(-7, "negative", "user", "cat"));
+      TS_ASSERT_EQUALS(select(store, "service:far"), std::vector<int>({2000000000}));
+      store.remove(2000000000);
+      TS_ASSERT(select(store, "service:far").empty());
+      TS_ASSERT_EQUALS(select(store, "category:cat").front(), -7);
+    }
+
+    void testConcurrentFirstQueries() {
+      EntryStore store;
+      for (int id = 1; id <= 2000; ++id) {
+        store.put(make(id, "Service" + std::to_string(id), "user" + std::to_string(id % 7), "cat"));
+      }
+
+      // every reader may be the one that builds the lazy indexes
+      std::vector<std::vector<int>> found(8);
+      std::vector<std::vector<int>> listed(8);
+      std::vector<std::vector<int>> stale(8);
+      std::vector<std::thread> readers;
+      for (size_t i = 0; i < found.size(); ++i) {
+        readers.emplace_back([&store, &found, &listed, &stale, i]() {
+          found[i] = store.select(Query::parse("service~ice19"));
+          listed[i] = store.orderedByService();
+          stale[i] = store.modifiedBetween(INT64_MIN, INT64_MAX);
+        });
+      }
+      for (auto& reader : readers) {
+        reader.join();
+      }
+      for (size_t i = 0; i < found.size(); ++i) {
+        TS_ASSERT_EQUALS(found[i], found[0]);
+        TS_ASSERT_EQUALS(listed[i], listed[0]);
+        TS_ASSERT_EQUALS(stale[i], stale[0]);
+      }
+      TS_ASSERT_EQUALS(found[0].size(), 111u);
+      TS_ASSERT_EQUALS(listed[0].size(), 2000u);
+      TS_ASSERT_EQUALS(stale[0].size(), 2000u);
+    }
+};
+
+#endif
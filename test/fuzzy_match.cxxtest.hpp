@@ -0,0 +1,94 @@
+#ifndef FUZZY_MATCH_CXXTEST_HPP
+#define FUZZY_MATCH_CXXTEST_HPP
+
+#include <cxxtest/TestSuite.h>
+#include "fuzzy_match.hpp"
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cctype>
+
+class FuzzyMatchTestSuite : public CxxTest::TestSuite {
+  private:
+    // textbook dynamic programming: fewest edits from pattern to any substring of text
+    static int reference(const std::string& pattern, const std::string& text) {
+      std::vector<int> column(pattern.size() + 1);
+      for (size_t i = 0; i <= pattern.size(); ++i) {
+        column[i] = i;
+      }
+      int best = column.back();
+      for (char c : text) {
+        int diagonal = column[0];
+        column[0] = 0;
+        for (size_t i = 1; i <= pattern.size(); ++i) {
+          int substitute = diagonal + (std::tolower(pattern[i - 1]) != std::tolower(c));
+          diagonal = column[i];
+          column[i] = std::min({substitute, column[i] + 1, column[i - 1] + 1});
+        }
+        best = std::min(best, column.back());
+      }
+      return best;
+    }
+
+  public:
+    void testDistanceMatchesReference() {
+      std::mt19937 random(7);
+      const std::string alphabet = "abcAB.";
+      auto draw = [&](size_t length) {
+        std::string s(length, ' ');
+        for (char& c : s) {
+          c = alphabet[random() % alphabet.size()];
+        }
+        return s;
+      };
+
+      for (int round = 0; round < 300; ++round) {
+        std::string pattern = draw(1 + random() % 12);
+        FuzzyMatcher matcher(pattern);
+        std::vector<std::string> texts;
+        for (int i = 0; i < 9; ++i) {
+          texts.push_back(draw(random() % 30));
+        }
+        std::vector<std::string_view> views(texts.begin(), texts.end());
+        std::vector<std::optional<FuzzyMatcher::Match>> batch(views.size());
+        matcher.match(views, batch);
+
+        for (size_t i = 0; i < texts.size(); ++i) {
+          int expected = reference(pattern, texts[i]);
+          std::optional<FuzzyMatcher::Match> single = matcher.match(texts[i]);
+          TS_ASSERT_EQUALS(single.has_value(), expected <= matcher.maxErrors());
+          TS_ASSERT_EQUALS(batch[i].has_value(), single.has_value());
+          if (single) {
+            TS_ASSERT_EQUALS(single->distance, expected);
+            TS_ASSERT_EQUALS(batch[i]->distance, expected);
+          }
+          // the filter never drops a real match
+          if (expected <= matcher.maxErrors()) {
+            TS_ASSERT(matcher.mayMatch(texts[i], expected));
+          }
+        }
+      }
+    }
+
+    void testRanking() {
+      FuzzyMatcher matcher("github");
+      TS_ASSERT_EQUALS(matcher.maxErrors(), 2);
+      // exact whole name, prefix, word start, inside a word
+      TS_ASSERT(*matcher.score("GitHub") > *matcher.score("GitHub Enterprise"));
+      TS_ASSERT(*matcher.score("GitHub Enterprise") > *matcher.score("my github"));
+      TS_ASSERT(*matcher.score("my github") > *matcher.score("mygithub"));
+      // fewer typos beat any bonus
+      TS_ASSERT(*matcher.score("mygithub") > *matcher.score("GitHib"));
+      TS_ASSERT(*matcher.score("GitHib") > *matcher.score("Gtihub"));
+      TS_ASSERT(!matcher.score("Gmail").has_value());
+
+      // too short for typos
+      FuzzyMatcher shortQuery("aw");
+      TS_ASSERT(shortQuery.score("AWS").has_value());
+      TS_ASSERT(!shortQuery.score("ax").has_value());
+      TS_ASSERT(!shortQuery.mayMatch("xyz", 0));
+    }
+};
+
+#endif
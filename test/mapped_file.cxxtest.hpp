@@ -0,0 +1,49 @@
+#ifndef MAPPED_FILE_CXXTEST_HPP
+#define MAPPED_FILE_CXXTEST_HPP
+
+#include <cxxtest/TestSuite.h>
+#include "mapped_file.hpp"
+#include "exceptions.hpp"
+#include <fstream>
+#include <cstdio>
+
+class MappedFileTestSuite : public CxxTest::TestSuite {
+  private:
+    std::string testFile;
+
+  public:
+    void setUp() {
+      testFile = "test_mapped.bin";
+      std::ofstream out(testFile, std::ios::binary);
+      int value = 1234;
+      out.write("OVLT", 4);
+      out.write(reinterpret_cast<const char*>(&value), sizeof(int));
+    }
+
+    void tearDown() {
+      std::remove(testFile.c_str());
+    }
+
+    void testReadWithinBounds() {
+      MappedFile file(testFile);
+
+      TS_ASSERT_EQUALS(file.size(), 8u);
+      TS_ASSERT_EQUALS(file.span(0, 4)[0], 'O');
+      TS_ASSERT_EQUALS(file.read<int>(4), 1234);
+      TS_ASSERT_EQUALS(file.span(8, 0).size(), 0u);
+    }
+
+    void testReadPastEndThrows() {
+      MappedFile file(testFile);
+
+      TS_ASSERT_THROWS(file.span(4, 5), CorruptedVaultException);
+      TS_ASSERT_THROWS(file.read<int>(6), CorruptedVaultException);
+      TS_ASSERT_THROWS(file.span(static_cast<size_t>(-1), 2), CorruptedVaultException);
+    }
+
+    void testMissingFileThrows() {
+      TS_ASSERT_THROWS(MappedFile("does_not_exist.bin"), FileException);
+    }
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <cxxtest/TestSuite.h>
 #include "password_entry.hpp"
+#include "password_generator.hpp"
 #include "exceptions.hpp"
 #include <unistd.h>
 
@@ -47,6 +48,23 @@ public:
     TS_ASSERT_EQUALS(entry2.getService(), entry1.getService());
   }
   
+  void testMoveLeavesSourceEmpty() {
+    PasswordEntry entry1(1, "service", "username", "a long password that lives on the heap");
+    const char* buffer = entry1.getPassword().data();
+
+    PasswordEntry entry2(std::move(entry1));
+    TS_ASSERT_EQUALS(entry2.getService(), "service");
+    // heap buffer is handed over, not copied
+    TS_ASSERT_EQUALS(entry2.getPassword().data(), buffer);
+    TS_ASSERT(entry1.getPassword().empty());
+
+    PasswordEntry entry3;
+    entry3 = std::move(entry2);
+    TS_ASSERT_EQUALS(entry3.getPassword(), "a long password that lives on the heap");
+    TS_ASSERT_EQUALS(entry3.getStrength(), PasswordGenerator::calculateStrength(entry3.getPassword()));
+    TS_ASSERT(entry2.getPassword().empty());
+  }
+  
   void testEqualityOperator() {
     PasswordEntry entry1(1, "service", "username", "password");
     PasswordEntry entry2(1, "test", "test", "test");
@@ -88,7 +106,7 @@ public:
     entry1.setCategory("category");
     entry1.setNotes("notes");
     
-    std::string serialized = entry1.serialize();
+    SecureString serialized = entry1.serialize();
     
     TS_ASSERT(serialized.find("service") != std::string::npos);
     TS_ASSERT(serialized.find("username") != std::string::npos);
@@ -105,6 +123,79 @@ public:
     TS_ASSERT_EQUALS(entry2.getNotes(), entry1.getNotes());
   }
   
+  void testSplitSerialization() {
+    PasswordEntry entry1(1, "service", "username", "pass|word");
+    entry1.setCategory("category");
+    entry1.setNotes("notes|more");
+
+    std::string index = entry1.serializeIndex();
+    TS_ASSERT(index.find("pass") == std::string::npos);
+
+    PasswordEntry entry2 = PasswordEntry::deserializeIndex(index);
+    TS_ASSERT(!entry2.hasSecrets());
+    TS_ASSERT_EQUALS(entry2.getService(), "service");
+    TS_ASSERT_EQUALS(entry2.getCategory(), "category");
+    TS_ASSERT_EQUALS(entry2.getStrength(), entry1.getStrength());
+
+    entry2.loadSecrets(entry1.serializeSecrets());
+    TS_ASSERT(entry2.hasSecrets());
+    TS_ASSERT_EQUALS(entry2.getPassword(), "pass|word");
+    TS_ASSERT_EQUALS(entry2.getNotes(), "notes|more");
+  }
+
+  void testWithoutSecretsKeepsIndexFields() {
+    PasswordEntry entry(4, "service", "username", "password");
+    entry.setUrl("url");
+    entry.setCategory("category");
+    entry.setNotes("notes");
+
+    PasswordEntry index = entry.withoutSecrets();
+    TS_ASSERT(!index.hasSecrets());
+    TS_ASSERT_EQUALS(index.getId(), 4);
+    TS_ASSERT_EQUALS(index.getUrl(), "url");
+    TS_ASSERT_EQUALS(index.getCategory(), "category");
+    TS_ASSERT_EQUALS(index.getModified(), entry.getModified());
+    TS_ASSERT_EQUALS(index.getStrength(), entry.getStrength());
+    TS_ASSERT_EQUALS(index.getPassword(), "");
+    TS_ASSERT_EQUALS(index.getNotes(), "");
+  }
+  
+  void testBinaryFormat() {
+    PasswordEntry entry1(300, "ser|vice", "user\nname", std::string("pass\0|word", 10));
+    entry1.setNotes(std::string(200, '|'));
+
+    SecureString serialized = entry1.serialize();
+    TS_ASSERT_EQUALS(static_cast<uint8_t>(serialized[0]), PasswordEntry::BINARY_FORMAT);
+
+    PasswordEntry entry2 = PasswordEntry::deserialize(serialized);
+    TS_ASSERT_EQUALS(entry2.getId(), 300);
+    TS_ASSERT_EQUALS(entry2.getService(), "ser|vice");
+    TS_ASSERT_EQUALS(entry2.getUsername(), "user\nname");
+    TS_ASSERT_EQUALS(entry2.getPassword(), entry1.getPassword());
+    TS_ASSERT_EQUALS(entry2.getNotes(), entry1.getNotes());
+    TS_ASSERT_EQUALS(entry2.getCreated(), entry1.getCreated());
+    TS_ASSERT_EQUALS(entry2.getModified(), entry1.getModified());
+
+    // every truncation and any trailing byte is rejected
+    for (size_t length = 0; length < serialized.size(); ++length) {
+      TS_ASSERT_THROWS_ANYTHING(PasswordEntry::deserialize(serialized.substr(0, length)));
+    }
+    TS_ASSERT_THROWS(PasswordEntry::deserialize(serialized + "x"), EntryException);
+    TS_ASSERT_THROWS(PasswordEntry::deserializeIndex(entry1.serializeIndex().substr(0, 10)), EntryException);
+  }
+
+  void testTextFormatStillReads() {
+    PasswordEntry entry = PasswordEntry::deserialize("7|service|username|password|url||category|1700000000|1700000100");
+    TS_ASSERT_EQUALS(entry.getId(), 7);
+    TS_ASSERT_EQUALS(entry.getPassword(), "password");
+    TS_ASSERT_EQUALS(entry.getNotes(), "");
+    TS_ASSERT_EQUALS(entry.getModified(), 1700000100);
+
+    // split records were never written as text
+    TS_ASSERT_THROWS(PasswordEntry::deserializeIndex("7|service|username|url|category|1700000000|1700000100|55"), EntryException);
+    TS_ASSERT_THROWS(entry.loadSecrets("4|pa|snotes"), EntryException);
+  }
+
   void testUpdateModified() {
     PasswordEntry entry;
     time_t before = entry.getModified();
@@ -0,0 +1,57 @@
+#ifndef PASSWORD_GENERATOR_CXXTEST_HPP
+#define PASSWORD_GENERATOR_CXXTEST_HPP
+
+#include <cxxtest/TestSuite.h>
+#include "password_generator.hpp"
+#include <string>
+#include <array>
+#include <stdexcept>
+
+class PasswordGeneratorTestSuite : public CxxTest::TestSuite {
+  public:
+    void testGenerateUsesOnlyChosenSets() {
+      SecureString digits = PasswordGenerator::generate(64, false, false, true, false);
+      TS_ASSERT_EQUALS(digits.size(), 64u);
+      TS_ASSERT_EQUALS(digits.find_first_not_of("0123456789"), SecureString::npos);
+
+      TS_ASSERT_THROWS(PasswordGenerator::generate(3), std::invalid_argument);
+      TS_ASSERT_THROWS(PasswordGenerator::generate(16, false, false, false, false), std::invalid_argument);
+    }
+
+    void testGenerateManyLayout() {
+      for (unsigned threads : {1u, 4u}) {
+        SecureString passwords = PasswordGenerator::generateMany(5000, 12, threads);
+        TS_ASSERT_EQUALS(passwords.size(), 5000u * 13);
+        for (size_t i = 0; i < passwords.size(); ++i) {
+          if (i % 13 == 12) {
+            TS_ASSERT_EQUALS(passwords[i], '\n');
+          }
+          else if (passwords[i] == '\n' || passwords[i] == '\0') {
+            TS_FAIL("line break inside a password");
+            break;
+          }
+        }
+      }
+      TS_ASSERT(PasswordGenerator::generateMany(0).empty());
+    }
+
+    void testGenerateManyIsUniform() {
+      // 88 characters, about 9000 draws each, every count far from 0 and from double
+      SecureString passwords = PasswordGenerator::generateMany(50000, 16);
+      std::array<int, 256> counts = {};
+      for (char c : passwords) {
+        ++counts[static_cast<unsigned char>(c)];
+      }
+      int used = 0;
+      for (int c = 0; c < 256; ++c) {
+        if (c == '\n' || counts[c] == 0) {
+          continue;
+        }
+        ++used;
+        TS_ASSERT(counts[c] > 8000 && counts[c] < 10200);
+      }
+      TS_ASSERT_EQUALS(used, 88);
+    }
+};
+
+#endif
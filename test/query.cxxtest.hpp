@@ -0,0 +1,80 @@
+#ifndef QUERY_CXXTEST_HPP
+#define QUERY_CXXTEST_HPP
+
+#include <cxxtest/TestSuite.h>
+#include "query.hpp"
+#include "exceptions.hpp"
+
+class QueryTestSuite : public CxxTest::TestSuite {
+  public:
+    void testFieldsAndOperators() {
+      Query query = Query::parse("category:work user~admin strength<=60 github");
+      const auto& clauses = query.clauses();
+      TS_ASSERT_EQUALS(clauses.size(), 4u);
+      TS_ASSERT(clauses[0].field == Query::Field::Category);
+      TS_ASSERT(clauses[0].op == Query::Op::Equals);
+      TS_ASSERT_EQUALS(clauses[0].text, "work");
+      TS_ASSERT(clauses[1].field == Query::Field::Username);
+      TS_ASSERT(clauses[1].op == Query::Op::Contains);
+      TS_ASSERT(clauses[2].field == Query::Field::Strength);
+      TS_ASSERT(clauses[2].op == Query::Op::LessEqual);
+      TS_ASSERT_EQUALS(clauses[2].number, 60);
+      TS_ASSERT(clauses[3].field == Query::Field::Any);
+      TS_ASSERT_EQUALS(clauses[3].text, "github");
+
+      TS_ASSERT(Query::parse("").clauses().empty());
+    }
+
+    void testAgesAndDates() {
+      const time_t now = 1000000000;
+      Query query = Query::parse("modified<90d created>=2w modified>1y", now);
+      const auto& clauses = query.clauses();
+      // younger than 90 days is a timestamp after now - 90 days
+      TS_ASSERT(clauses[0].op == Query::Op::Greater);
+      TS_ASSERT_EQUALS(clauses[0].number, now - 90 * 86400);
+      TS_ASSERT(clauses[1].op == Query::Op::LessEqual);
+      TS_ASSERT_EQUALS(clauses[1].number, now - 14 * 86400);
+      TS_ASSERT(clauses[2].op == Query::Op::Less);
+      TS_ASSERT_EQUALS(Query::ageSeconds("180d"), 180 * 86400);
+
+      // dates keep their operator
+      Query dated = Query::parse("modified<2025-01-31");
+      TS_ASSERT(dated.clauses()[0].op == Query::Op::Less);
+      TS_ASSERT(dated.clauses()[0].number > Query::parse("modified<2025-01-30").clauses()[0].number);
+    }
+
+    void testPlainWords() {
+      // unknown prefixes and missing operators are plain words
+      Query query = Query::parse("https://x.com a<b \"two words\" service");
+      const auto& clauses = query.clauses();
+      TS_ASSERT_EQUALS(clauses.size(), 4u);
+      TS_ASSERT_EQUALS(clauses[0].text, "https://x.com");
+      TS_ASSERT_EQUALS(clauses[1].text, "a<b");
+      TS_ASSERT_EQUALS(clauses[2].text, "two words");
+      TS_ASSERT_EQUALS(clauses[3].text, "service");
+      for (const auto& clause : clauses) {
+        TS_ASSERT(clause.field == Query::Field::Any);
+      }
+
+      Query grouped = Query::parse("\"category:my work\"");
+      TS_ASSERT(grouped.clauses()[0].field == Query::Field::Category);
+      TS_ASSERT_EQUALS(grouped.clauses()[0].text, "my work");
+    }
+
+    void testMalformedTerms() {
+      TS_ASSERT_THROWS(Query::parse("\"unclosed"), QueryException);
+      TS_ASSERT_THROWS(Query::parse("category:"), QueryException);
+      TS_ASSERT_THROWS(Query::parse("service<abc"), QueryException);
+      TS_ASSERT_THROWS(Query::parse("strength<weak"), QueryException);
+      TS_ASSERT_THROWS(Query::parse("modified~90d"), QueryException);
+      TS_ASSERT_THROWS(Query::parse("modified<90x"), QueryException);
+      TS_ASSERT_THROWS(Query::parse("created>2025-13-01"), QueryException);
+      TS_ASSERT_THROWS(Query::ageSeconds("180"), QueryException);
+    // would overflow int64 seconds
+    TS_ASSERT_THROWS(Query::parse("modified<99999999999999y"), QueryException);
+    TS_ASSERT_THROWS(Query::ageSeconds("9223372036854775807h"), QueryException);
+    TS_ASSERT_EQUALS(Query::ageSeconds("292471208677y"), 292471208677LL * 365 * 86400);
+    }
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef SECURE_MEMORY_CXXTEST_HPP
+#define SECURE_MEMORY_CXXTEST_HPP
+
+#include <cxxtest/TestSuite.h>
+#include "secure_memory.hpp"
+#include <cstring>
+#include <cstdint>
+
+class SecureMemoryTestSuite : public CxxTest::TestSuite {
+  public:
+    void testFreedBlockIsWipedAndReused() {
+      size_t before = SecureArena::inUse();
+      char* block = static_cast<char*>(SecureArena::allocate(100));
+      TS_ASSERT_EQUALS(reinterpret_cast<uintptr_t>(block) % 16, 0u);
+      TS_ASSERT_EQUALS(SecureArena::inUse(), before + 128);
+      std::memset(block, 'x', 100);
+
+      SecureArena::deallocate(block, 100);
+      TS_ASSERT_EQUALS(SecureArena::inUse(), before);
+      // first bytes hold the free list link, the rest must be zero
+      for (size_t i = sizeof(void*); i < 128; ++i) {
+        TS_ASSERT_EQUALS(block[i], 0);
+      }
+
+      // same class comes back off the free list
+      char* again = static_cast<char*>(SecureArena::allocate(120));
+      TS_ASSERT_EQUALS(again, block);
+      SecureArena::deallocate(again, 120);
+    }
+
+    void testLargeBlockGetsOwnMapping() {
+      size_t before = SecureArena::inUse();
+      size_t size = SecureArena::MAX_BLOCK * 3 + 1;
+      uint8_t* block = static_cast<uint8_t*>(SecureArena::allocate(size));
+      std::memset(block, 0xab, size);
+      TS_ASSERT_EQUALS(SecureArena::inUse(), before + size);
+      SecureArena::deallocate(block, size);
+      TS_ASSERT_EQUALS(SecureArena::inUse(), before);
+    }
+
+    void testContainersUseArena() {
+      size_t before = SecureArena::inUse();
+      {
+        SecureString secret(40, 's');
+        // grows through several size classes
+        for (int i = 0; i < 10; ++i) {
+          secret += secret;
+        }
+        SecureBytes key(32, 7);
+        TS_ASSERT_LESS_THAN(before, SecureArena::inUse());
+        TS_ASSERT_EQUALS(secret.size(), 40u * 1024);
+        TS_ASSERT_EQUALS(key[31], 7);
+      }
+      TS_ASSERT_EQUALS(SecureArena::inUse(), before);
+    }
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef SECURE_RANDOM_CXXTEST_HPP
+#define SECURE_RANDOM_CXXTEST_HPP
+
+#include <cxxtest/TestSuite.h>
+#include "secure_random.hpp"
+#include <vector>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/wait.h>
+
+class SecureRandomTestSuite : public CxxTest::TestSuite {
+  public:
+    void testFillAcrossRefills() {
+      // more than one buffer in small pieces, then one large request
+      std::vector<uint8_t> first(SecureRandom::BUFFER_SIZE * 3);
+      for (size_t offset = 0; offset < first.size(); offset += 16) {
+        SecureRandom::fill(std::span<uint8_t>(first).subspan(offset, 16));
+      }
+      std::vector<uint8_t> second(SecureRandom::BUFFER_SIZE * 3);
+      SecureRandom::fill(second);
+
+      TS_ASSERT_DIFFERS(first, second);
+      // 12 KB of zeroes would mean the buffer was handed out after a wipe
+      TS_ASSERT_DIFFERS(first, std::vector<uint8_t>(first.size(), 0));
+    }
+
+    void testUniformStaysInBound() {
+      std::vector<int> seen(7, 0);
+      for (int i = 0; i < 7000; ++i) {
+        uint32_t value = SecureRandom::uniform(7);
+        TS_ASSERT_LESS_THAN(value, 7u);
+        seen[value]++;
+      }
+      for (int count : seen) {
+        TS_ASSERT_LESS_THAN(0, count);
+      }
+      TS_ASSERT_EQUALS(SecureRandom::uniform(1), 0u);
+      TS_ASSERT_THROWS_ANYTHING(SecureRandom::uniform(0));
+    }
+
+    void testChildAfterForkGetsOwnBytes() {
+      // leave unused bytes in this thread's buffer
+      uint8_t warm[8];
+      SecureRandom::fill(warm);
+
+      int pipes[2];
+      TS_ASSERT_EQUALS(pipe(pipes), 0);
+      pid_t pid = fork();
+      if (pid == 0) {
+        uint8_t child[16];
+        SecureRandom::fill(child);
+        ssize_t written = write(pipes[1], child, sizeof(child));
+        _exit(written == sizeof(child) ? 0 : 1);
+      }
+      close(pipes[1]);
+
+      uint8_t parent[16];
+      SecureRandom::fill(parent);
+      uint8_t child[16] = {};
+      TS_ASSERT_EQUALS(read(pipes[0], child, sizeof(child)), 16);
+      close(pipes[0]);
+      int status = 0;
+      waitpid(pid, &status, 0);
+
+      TS_ASSERT_DIFFERS(std::vector<uint8_t>(parent, parent + 16), std::vector<uint8_t>(child, child + 16));
+    }
+};
+
+#endif
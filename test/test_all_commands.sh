@@ -15,7 +15,7 @@ echo "======================================"
 echo ""
 
 # Cleanup from previous runs
-rm -f $VAULT *.csv *.backup 2>/dev/null
+rm -f $VAULT $VAULT.journal *.csv *.backup 2>/dev/null
 
 echo "Test 1: Create vault"
 echo $PASSWORD | $BIN $VAULT create << EOF
@@ -109,6 +109,11 @@ $BIN $VAULT generate 20
 echo "Password generated"
 echo ""
 
+echo "Test 8b: Bulk generate"
+test "$($BIN $VAULT generate 24 --count 1000 --threads 2 | wc -l)" -eq 1000
+echo "Passwords generated"
+echo ""
+
 echo "Test 9: Export to CSV"
 $BIN $VAULT export test_export.csv << EOF
 $PASSWORD
@@ -147,8 +152,27 @@ EOF
 echo "Deletion verified"
 echo ""
 
+echo "Test 14: Batch script"
+$BIN $VAULT batch << EOF
+NewPassword456!
+add-password
+Batch Entry
+batch@example.com
+batchpass123
+
+Batch
+
+search "batch entry"
+search category:batch user~BATCH@ modified<1d
+find "bach entyr" 3
+stale --older-than 30d
+info
+EOF
+echo "Batch script ran"
+echo ""
+
 # Cleanup
-rm -f $VAULT test_export.csv *.backup
+rm -f $VAULT $VAULT.journal test_export.csv *.backup
 
 echo "======================================"
 echo "All tests passed"
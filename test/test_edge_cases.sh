@@ -79,7 +79,19 @@ EOF
 echo "Search in empty vault handled"
 echo ""
 
+# Test 7: Invalid agent timeout
+echo "Test 7: Invalid agent timeout"
+for ttl in 0 -5 10x abc; do
+    $BIN $VAULT agent $ttl < /dev/null
+    if [ $? -ne 0 ]; then
+        echo "Correctly rejected agent timeout $ttl"
+    else
+        echo "FAILED: Should reject agent timeout $ttl"
+    fi
+done
+echo ""
+
 # Cleanup
-rm -f $VAULT
+rm -f $VAULT $VAULT.journal
 
 echo "Edge case testing complete!"
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef TEXT_MATCH_CXXTEST_HPP
+#define TEXT_MATCH_CXXTEST_HPP
+
+#include <cxxtest/TestSuite.h>
+#include "text_match.hpp"
+#include <string>
+#include <algorithm>
+#include <cctype>
+#include <random>
+
+class TextMatchTestSuite : public CxxTest::TestSuite {
+  private:
+    // lower-cased copies and find, what the kernels replace
+    static bool reference(std::string text, std::string query) {
+      auto lower = [](unsigned char c) { return static_cast<char>(std::tolower(c)); };
+      std::transform(text.begin(), text.end(), text.begin(), lower);
+      std::transform(query.begin(), query.end(), query.begin(), lower);
+      return text.find(query) != std::string::npos;
+    }
+
+    static std::vector<TextMatch::Kernel> kernels() {
+      std::vector<TextMatch::Kernel> result;
+      for (auto kernel : {TextMatch::Kernel::Scalar, TextMatch::Kernel::SSE2, TextMatch::Kernel::AVX2}) {
+        if (TextMatch::supported(kernel)) {
+          result.push_back(kernel);
+        }
+      }
+      return result;
+    }
+
+  public:
+    void testMatchesAtEveryPosition() {
+      // match at each offset of a text longer than two vector blocks
+      std::string text(80, '.');
+      for (auto kernel : kernels()) {
+        for (size_t at = 0; at + 5 <= text.size(); ++at) {
+          std::string placed = text;
+          placed.replace(at, 5, "GiTHu");
+          TS_ASSERT(TextMatch::containsIgnoreCase(placed, "githu", kernel));
+          TS_ASSERT(TextMatch::containsIgnoreCase(placed, "G", kernel));
+          TS_ASSERT(!TextMatch::containsIgnoreCase(placed, "githa", kernel));
+        }
+        TS_ASSERT(TextMatch::containsIgnoreCase("abc", "", kernel));
+        TS_ASSERT(!TextMatch::containsIgnoreCase("ab", "abc", kernel));
+        // only ascii letters fold
+        TS_ASSERT(!TextMatch::containsIgnoreCase("[\\]", "{|}", kernel));
+        TS_ASSERT(!TextMatch::containsIgnoreCase("\xc3\x89t\xc3\xa9", "\xc3\xa9T\xc3\xa9", kernel));
+      }
+    }
+
+    void testKernelsAgreeWithReference() {
+      std::mt19937 random(42);
+      const std::string alphabet = "aAbBzZ@[`{\x80\xff";
+      auto draw = [&](size_t length) {
+        std::string s(length, ' ');
+        for (char& c : s) {
+          c = alphabet[random() % alphabet.size()];
+        }
+        return s;
+      };
+
+      for (int round = 0; round < 2000; ++round) {
+        std::string text = draw(random() % 100);
+        std::string query = draw(1 + random() % 4);
+        bool expected = reference(text, query);
+        for (auto kernel : kernels()) {
+          TS_ASSERT_EQUALS(TextMatch::containsIgnoreCase(text, query, kernel), expected);
+        }
+        TS_ASSERT_EQUALS(TextMatch::containsIgnoreCase(text, query), expected);
+      }
+    }
+};
+
+#endif
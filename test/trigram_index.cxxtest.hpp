@@ -0,0 +1,42 @@
+#ifndef TRIGRAM_INDEX_CXXTEST_HPP
+#define TRIGRAM_INDEX_CXXTEST_HPP
+
+#include <cxxtest/TestSuite.h>
+#include "trigram_index.hpp"
+
+class TrigramIndexTestSuite : public CxxTest::TestSuite {
+  public:
+    void testCandidatesHoldEveryTrigram() {
+      TrigramIndex index;
+      index.add(1, {"GitHub", "alice"});
+      index.add(2, {"GitLab", "bob"});
+      index.add(3, {"Gmail", "alice.github"});
+
+      TS_ASSERT_EQUALS(*index.candidates("git"), std::vector<int>({1, 2, 3}));
+      TS_ASSERT_EQUALS(*index.candidates("GITHUB"), std::vector<int>({1, 3}));
+      TS_ASSERT(index.candidates("gitx")->empty());
+      // too short to narrow down
+      TS_ASSERT(!index.candidates("gi").has_value());
+    }
+
+    void testUpdateAndRemove() {
+      TrigramIndex index;
+      index.add(1, {"GitHub"});
+      index.add(2, {"GitLab"});
+
+      index.update(1, {"GitHub"}, {"Gitea"});
+      TS_ASSERT(index.candidates("hub")->empty());
+      TS_ASSERT_EQUALS(*index.candidates("tea"), std::vector<int>({1}));
+      TS_ASSERT_EQUALS(*index.candidates("git"), std::vector<int>({1, 2}));
+
+      index.remove(2, {"GitLab"});
+      TS_ASSERT_EQUALS(*index.candidates("git"), std::vector<int>({1}));
+      TS_ASSERT(index.candidates("lab")->empty());
+
+      // ids out of order still end up sorted
+      index.add(0, {"gitweb"});
+      TS_ASSERT_EQUALS(*index.candidates("git"), std::vector<int>({0, 1}));
+    }
+};
+
+#endif
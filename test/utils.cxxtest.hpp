@@ -69,6 +69,14 @@ class UtilsTestSuite : public CxxTest::TestSuite {
       std::string hex = Utils::bytesToHex(empty_bytes);
       TS_ASSERT_EQUALS(hex, "");
     }
+
+    void testContainsIgnoreCase() {
+      TS_ASSERT(Utils::containsIgnoreCase("GitHub Enterprise", "hub ent"));
+      TS_ASSERT(Utils::containsIgnoreCase("github", "GITHUB"));
+      TS_ASSERT(Utils::containsIgnoreCase("", ""));
+      TS_ASSERT(!Utils::containsIgnoreCase("git", "github"));
+      TS_ASSERT(!Utils::containsIgnoreCase("gitlab", "hub"));
+    }
 };
 
 #endif
@@ -6,6 +6,10 @@
 #include "password_entry.hpp"
 #include "exceptions.hpp"
 #include <cstdio>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <openssl/sha.h>
 
 class VaultTestSuite : public CxxTest::TestSuite {
 private:
@@ -15,10 +19,12 @@ private:
 public:
   void setUp() {
     std::remove(testVaultFile.c_str());
+    std::remove((testVaultFile + ".journal").c_str());
   }
 
   void tearDown() {
     std::remove(testVaultFile.c_str());
+    std::remove((testVaultFile + ".journal").c_str());
   }
 
   void testCreateVault() {
@@ -120,6 +126,34 @@ public:
     }
   }
 
+  void testListEntriesLeavesSecretsSealed() {
+    {
+      Vault vault(testVaultFile);
+      vault.create(testPassword);
+      PasswordEntry entry(0, "service", "username", "password");
+      entry.setNotes("notes");
+      vault.addEntry(entry);
+    }
+
+    Vault vault(testVaultFile);
+    vault.open(testPassword);
+
+    auto listed = vault.listEntries();
+    TS_ASSERT_EQUALS(listed.size(), 1);
+    TS_ASSERT_EQUALS(listed[0].getService(), "service");
+    TS_ASSERT(!listed[0].hasSecrets());
+    TS_ASSERT_EQUALS(listed[0].getPassword(), "");
+    TS_ASSERT_EQUALS(listed[0].getStrength(), PasswordEntry(0, "", "", "password").getStrength());
+
+    PasswordEntry full = vault.getEntry(listed[0].getId());
+    TS_ASSERT(full.hasSecrets());
+    TS_ASSERT_EQUALS(full.getPassword(), "password");
+    TS_ASSERT_EQUALS(full.getNotes(), "notes");
+
+    // index only copy must not wipe the stored password
+    TS_ASSERT_THROWS(vault.updateEntry(listed[0]), EntryException);
+  }
+
   void testDeleteEntry() {
     Vault vault(testVaultFile);
     vault.create(testPassword);
@@ -154,10 +188,160 @@ public:
     vault.addEntry(entry2);
     vault.addEntry(entry3);
 
-    auto results = vault.searchByService("service");
+    auto results = vault.search("service~service");
     TS_ASSERT_EQUALS(results.size(), 3);
   }
 
+  void testSearchIgnoresCase() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+
+    PasswordEntry entry1(0, "GitHub", "alice", "password1");
+    PasswordEntry entry2(0, "Gmail", "bob", "password2");
+    entry2.setCategory("Personal");
+    PasswordEntry entry3(0, "AWS", "admin", "password3");
+
+    vault.addEntry(entry1);
+    vault.addEntry(entry2);
+    vault.addEntry(entry3);
+
+    TS_ASSERT_EQUALS(vault.search("github").size(), 1);
+    TS_ASSERT_EQUALS(vault.search("BOB").size(), 1);
+    TS_ASSERT_EQUALS(vault.search("personal").size(), 1);
+    TS_ASSERT_EQUALS(vault.search("nothing").size(), 0);
+  }
+
+  void testSearchFollowsEdits() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+
+    PasswordEntry entry(0, "GitHub", "alice", "password1");
+    entry.setUrl("https://github.com/login");
+    int id = vault.addEntry(entry);
+    vault.addEntry(PasswordEntry(0, "Gmail", "bob", "password2"));
+
+    // url is searched too, and the index built here must follow later changes
+    TS_ASSERT_EQUALS(vault.search("GITHUB.COM").size(), 1);
+    TS_ASSERT_EQUALS(vault.search("service~hub").size(), 1);
+    TS_ASSERT_EQUALS(vault.search("user~hub").size(), 0);
+
+    PasswordEntry edited = vault.getEntry(id);
+    edited.setService("GitLab");
+    edited.setUrl("");
+    vault.updateEntry(edited);
+    TS_ASSERT_EQUALS(vault.search("github").size(), 0);
+    TS_ASSERT_EQUALS(vault.search("gitlab").size(), 1);
+
+    vault.addEntry(PasswordEntry(0, "GitLab mirror", "carol", "password3"));
+    TS_ASSERT_EQUALS(vault.search("gitlab").size(), 2);
+    vault.deleteEntry(id);
+    TS_ASSERT_EQUALS(vault.search("gitlab").size(), 1);
+  }
+
+  void testSearchFilterExpressions() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+
+    PasswordEntry admin(0, "Jira", "admin", "abc");
+    admin.setCategory("Work");
+    vault.addEntry(admin);
+    PasswordEntry strong(0, "Jenkins", "admin", "x9$Kq!2vLp#7Zr@m");
+    strong.setCategory("work");
+    vault.addEntry(strong);
+    vault.addEntry(PasswordEntry(0, "Netflix", "admin", "abc"));
+
+    auto results = vault.search("category:work modified<90d strength<60 user~ADMIN");
+    TS_ASSERT_EQUALS(results.size(), 1u);
+    TS_ASSERT_EQUALS(results[0].getService(), "Jira");
+    TS_ASSERT_EQUALS(vault.search("\"category:work\" created>1h").size(), 0u);
+    TS_ASSERT_EQUALS(vault.search("admin").size(), 3u);
+    TS_ASSERT_THROWS(vault.search("strength<weak"), QueryException);
+  }
+
+  void testStaleEntriesOldestFirst() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+    for (int i = 0; i < 4; ++i) {
+      vault.addEntry(PasswordEntry(0, "Service" + std::to_string(i), "user", "password"));
+    }
+    time_t now = time(nullptr);
+    auto stale = [&vault](time_t cutoff) {
+      std::vector<int> found;
+      vault.forEachModifiedBefore(cutoff, [&found](const PasswordEntry& entry) {
+        found.push_back(entry.getId());
+      });
+      return found;
+    };
+    TS_ASSERT(stale(now - 3600).empty());
+
+    // entries edited with old timestamps, as a vault written long ago would hold them
+    vault.updateEntry(PasswordEntry::deserialize("3|Service2|user|password|||old|1000|" + std::to_string(now - 400 * 86400)));
+    vault.updateEntry(PasswordEntry::deserialize("1|Service0|user|password|||old|1000|" + std::to_string(now - 200 * 86400)));
+    TS_ASSERT_EQUALS(stale(now - 180 * 86400), std::vector<int>({3, 1}));
+    TS_ASSERT_EQUALS(stale(now - 365 * 86400), std::vector<int>({3}));
+
+    // an edit makes it current again, and a save and reopen rebuilds the same order
+    PasswordEntry rotated = vault.getEntry(3);
+    rotated.setPassword("rotated");
+    vault.updateEntry(rotated);
+    vault.deleteEntry(2);
+    TS_ASSERT_EQUALS(stale(now - 180 * 86400), std::vector<int>({1}));
+    vault.save();
+    vault.close();
+    vault.open(testPassword);
+    TS_ASSERT_EQUALS(stale(now - 180 * 86400), std::vector<int>({1}));
+    TS_ASSERT_EQUALS(vault.search("modified>180d category:OLD").size(), 1u);
+  }
+
+  void testFuzzySearchRanksTypos() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+
+    vault.addEntry(PasswordEntry(0, "GitLab", "alice", "password1"));
+    vault.addEntry(PasswordEntry(0, "GitHub Enterprise", "alice", "password2"));
+    vault.addEntry(PasswordEntry(0, "GitHub", "bob", "password3"));
+    PasswordEntry work(0, "Work code", "carol", "password4");
+    work.setUrl("https://www.github.com/login");
+    vault.addEntry(work);
+    vault.addEntry(PasswordEntry(0, "Gmail", "dave", "password5"));
+
+    auto results = vault.fuzzySearch("githb", 3);
+    TS_ASSERT_EQUALS(results.size(), 3u);
+    TS_ASSERT_EQUALS(results[0].getService(), "GitHub");
+    TS_ASSERT_EQUALS(results[1].getService(), "Work code");
+    TS_ASSERT_EQUALS(results[2].getService(), "GitHub Enterprise");
+
+    // the bounded heap keeps the best one, not the first one
+    results = vault.fuzzySearch("gitlab", 1);
+    TS_ASSERT_EQUALS(results.size(), 1u);
+    TS_ASSERT_EQUALS(results[0].getService(), "GitLab");
+    TS_ASSERT(vault.fuzzySearch("zzzzzz", 5).empty());
+  }
+
+  void testForEachVisitsStoredEntries() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+    vault.addEntry(PasswordEntry(0, "GitHub", "alice", "password1"));
+    vault.addEntry(PasswordEntry(0, "Gmail", "bob", "password2"));
+
+    // index views built from the columns, in id order
+    std::vector<int> first;
+    vault.forEachEntry([&first](const PasswordEntry& entry) {
+      TS_ASSERT(!entry.hasSecrets());
+      first.push_back(entry.getId());
+    });
+    TS_ASSERT_EQUALS(first.size(), 2u);
+    TS_ASSERT_EQUALS(vault.getEntry(first[0]).getService(), "GitHub");
+
+    std::vector<int> matches;
+    vault.forEachMatch("GMAIL", [&matches](const PasswordEntry& entry) {
+      TS_ASSERT_EQUALS(entry.getUsername(), "bob");
+      matches.push_back(entry.getId());
+    });
+    TS_ASSERT_EQUALS(matches.size(), 1u);
+    TS_ASSERT_EQUALS(matches[0], first[1]);
+  }
+
   void testMultipleEntries() {
     Vault vault(testVaultFile);
     vault.create(testPassword);
@@ -172,6 +356,424 @@ public:
     auto allEntries = vault.getAllEntries();
     TS_ASSERT_EQUALS(allEntries.size(), 10);
   }
+
+  void testSaveAndOpenWithWorkerThreads() {
+    {
+      // several save chunks written by parallel workers
+      Vault vault(testVaultFile);
+      vault.setThreads(4);
+      vault.create(testPassword);
+      vault.beginBatch();
+      for (int i = 0; i < 3000; ++i) {
+        vault.addEntry(PasswordEntry(0, "service" + std::to_string(i), "user", "password" + std::to_string(i)));
+      }
+      vault.commit();
+      vault.compact();
+    }
+
+    for (unsigned threads : {1u, 4u}) {
+      Vault vault(testVaultFile);
+      vault.setThreads(threads);
+      vault.open(testPassword);
+      TS_ASSERT_EQUALS(vault.getEntryCount(), 3000);
+      TS_ASSERT_EQUALS(vault.getEntry(1).getService(), "service0");
+      TS_ASSERT_EQUALS(vault.getEntry(3000).getPassword(), "password2999");
+      TS_ASSERT_EQUALS(vault.getEntry(500).getService(), "service499");
+    }
+  }
+
+  void testTruncatedVaultIsCorrupted() {
+    {
+      Vault vault(testVaultFile);
+      vault.create(testPassword);
+      vault.addEntry(PasswordEntry(0, "service", "username", "password"));
+      vault.compact();
+    }
+
+    // cut into the last record
+    std::filesystem::resize_file(testVaultFile, std::filesystem::file_size(testVaultFile) - 10);
+    Vault vault(testVaultFile);
+    TS_ASSERT_THROWS(vault.open(testPassword), CorruptedVaultException);
+
+    // shorter than a header
+    std::filesystem::resize_file(testVaultFile, 20);
+    Vault shortVault(testVaultFile);
+    TS_ASSERT_THROWS(shortVault.open(testPassword), CorruptedVaultException);
+  }
+
+  void testLookupReadsOneEntry() {
+    {
+      Vault vault(testVaultFile);
+      vault.create(testPassword);
+      for (int i = 1; i <= 3; ++i) {
+        vault.addEntry(PasswordEntry(0, "service" + std::to_string(i), "user", "password" + std::to_string(i)));
+      }
+
+      // no offset table until the first full write
+      Vault before(testVaultFile);
+      TS_ASSERT_EQUALS(before.lookup(testPassword, 2).getPassword(), "password2");
+
+      vault.compact();
+      PasswordEntry changed = vault.getEntry(2);
+      changed.setPassword("changed");
+      vault.updateEntry(changed);
+      vault.deleteEntry(3);
+    }
+
+    Vault vault(testVaultFile);
+    TS_ASSERT_EQUALS(vault.lookup(testPassword, 1).getPassword(), "password1");
+    TS_ASSERT_EQUALS(vault.lookup(testPassword, 1).getService(), "service1");
+    // journal wins over the snapshot
+    TS_ASSERT_EQUALS(vault.lookup(testPassword, 2).getPassword(), "changed");
+    TS_ASSERT_THROWS(vault.lookup(testPassword, 3), EntryException);
+    TS_ASSERT_THROWS(vault.lookup(testPassword, 42), EntryException);
+    TS_ASSERT_THROWS(vault.lookup("WrongPassword", 1), InvalidPasswordException);
+    TS_ASSERT(!vault.isVaultOpen());
+
+    // table is only trailing data for a full open
+    vault.open(testPassword);
+    TS_ASSERT_EQUALS(vault.getEntryCount(), 2);
+  }
+
+  void testCipherModeRecordedInHeader() {
+    {
+      Vault vault(testVaultFile);
+      vault.setCipherMode(CipherMode::CBC);
+      vault.create(testPassword);
+      vault.addEntry(PasswordEntry(0, "service", "username", "password"));
+      vault.compact();
+    }
+    {
+      Vault vault(testVaultFile);
+      vault.setCipherMode(CipherMode::CBC);
+      vault.open(testPassword);
+      TS_ASSERT_EQUALS(vault.getCipherMode(), CipherMode::CBC);
+
+      // next full write re-encrypts everything
+      vault.setCipherMode(CipherMode::GCM);
+      vault.compact();
+      TS_ASSERT_EQUALS(vault.getCipherMode(), CipherMode::GCM);
+    }
+
+    Vault vault(testVaultFile);
+    vault.open(testPassword);
+    TS_ASSERT_EQUALS(vault.getCipherMode(), CipherMode::GCM);
+    TS_ASSERT_EQUALS(vault.getEntry(1).getPassword(), "password");
+  }
+
+  void testTamperedRecordIsCorrupted() {
+    {
+      Vault vault(testVaultFile);
+      vault.create(testPassword);
+      vault.addEntry(PasswordEntry(0, "service", "username", "password"));
+      vault.compact();
+    }
+
+    // flip one ciphertext byte of the first index record
+    // header(128) + count record(16 + 4 + 20) + iv(16) + size(4)
+    std::fstream file(testVaultFile, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekg(188);
+    char byte = 0;
+    file.read(&byte, 1);
+    byte ^= 0x01;
+    file.seekp(188);
+    file.write(&byte, 1);
+    file.close();
+
+    Vault vault(testVaultFile);
+    TS_ASSERT_THROWS(vault.open(testPassword), CorruptedVaultException);
+  }
+
+  void testJournalReplay() {
+    int keep = 0;
+    {
+      Vault vault(testVaultFile);
+      vault.create(testPassword);
+
+      keep = vault.addEntry(PasswordEntry(0, "service1", "username1", "password1"));
+      int gone = vault.addEntry(PasswordEntry(0, "service2", "username2", "password2"));
+
+      PasswordEntry entry = vault.getEntry(keep);
+      entry.setUsername("updated");
+      vault.updateEntry(entry);
+      vault.deleteEntry(gone);
+
+      TS_ASSERT(vault.getJournalSize() > 0);
+    }
+    {
+      Vault vault(testVaultFile);
+      vault.open(testPassword);
+
+      TS_ASSERT_EQUALS(vault.getEntryCount(), 1);
+      TS_ASSERT_EQUALS(vault.getEntry(keep).getUsername(), "updated");
+
+      // ids keep counting past replayed entries
+      int id = vault.addEntry(PasswordEntry(0, "service3", "username3", "password3"));
+      TS_ASSERT_EQUALS(id, 3);
+    }
+  }
+
+  void testCompactFoldsJournal() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+    vault.addEntry(PasswordEntry(0, "service", "username", "password"));
+
+    vault.compact();
+    TS_ASSERT_EQUALS(vault.getJournalSize(), 0);
+
+    std::ifstream journal(testVaultFile + ".journal");
+    TS_ASSERT(!journal.good());
+    vault.close();
+
+    Vault reopened(testVaultFile);
+    reopened.open(testPassword);
+    TS_ASSERT_EQUALS(reopened.getEntryCount(), 1);
+  }
+
+  void testTornJournalTailIgnored() {
+    {
+      Vault vault(testVaultFile);
+      vault.create(testPassword);
+      vault.addEntry(PasswordEntry(0, "service", "username", "password"));
+    }
+
+    // half written record at the end
+    std::ofstream journal(testVaultFile + ".journal", std::ios::binary | std::ios::app);
+    journal.write("0123456789", 10);
+    journal.close();
+
+    Vault vault(testVaultFile);
+    vault.open(testPassword);
+    TS_ASSERT_EQUALS(vault.getEntryCount(), 1);
+
+    vault.addEntry(PasswordEntry(0, "service2", "username2", "password2"));
+    vault.close();
+
+    Vault reopened(testVaultFile);
+    reopened.open(testPassword);
+    TS_ASSERT_EQUALS(reopened.getEntryCount(), 2);
+  }
+
+  void testNonJournaledWritesSnapshot() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+    vault.setJournaling(false);
+
+    vault.addEntry(PasswordEntry(0, "service", "username", "password"));
+    TS_ASSERT_EQUALS(vault.getJournalSize(), 0);
+  }
+
+  void testBatchBulkInsertSingleWrite() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+    long writesBefore = vault.getWriteCount();
+
+    vault.beginBatch();
+    for (int i = 0; i < 10000; ++i) {
+      vault.addEntry(PasswordEntry(0, "Service" + std::to_string(i), "user", "pass"));
+    }
+    // nothing written until commit
+    TS_ASSERT_EQUALS(vault.getWriteCount(), writesBefore);
+    vault.commit();
+
+    TS_ASSERT_EQUALS(vault.getWriteCount(), writesBefore + 1);
+    vault.close();
+
+    Vault reopened(testVaultFile);
+    reopened.open(testPassword);
+    TS_ASSERT_EQUALS(reopened.getEntryCount(), 10000);
+  }
+
+  void testBatchRollback() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+    int id = vault.addEntry(PasswordEntry(0, "service", "username", "password"));
+
+    vault.beginBatch();
+    vault.addEntry(PasswordEntry(0, "service2", "username2", "password2"));
+    PasswordEntry entry = vault.getEntry(id);
+    entry.setUsername("changed");
+    vault.updateEntry(entry);
+    vault.rollback();
+
+    TS_ASSERT_EQUALS(vault.getEntryCount(), 1);
+    TS_ASSERT_EQUALS(vault.getEntry(id).getUsername(), "username");
+
+    // ids reused after rollback
+    TS_ASSERT_EQUALS(vault.addEntry(PasswordEntry(0, "service3", "username3", "password3")), id + 1);
+  }
+
+  void testNoWriteInsideBatch() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+    long writesBefore = vault.getWriteCount();
+
+    vault.beginBatch();
+    vault.addEntry(PasswordEntry(0, "service", "username", "password"));
+    TS_ASSERT_THROWS(vault.save(), CustomException);
+    TS_ASSERT_THROWS(vault.compact(), CustomException);
+    TS_ASSERT_THROWS(vault.changeMasterPassword("NewPassword456!"), CustomException);
+    TS_ASSERT_EQUALS(vault.getWriteCount(), writesBefore);
+
+    // rollback leaves the file as it was
+    vault.rollback();
+    vault.close();
+    Vault reopened(testVaultFile);
+    reopened.open(testPassword);
+    TS_ASSERT_EQUALS(reopened.getEntryCount(), 0);
+  }
+
+  void testTransactionRollsBackUnlessCommitted() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+
+    {
+      Vault::Transaction transaction(vault);
+      vault.addEntry(PasswordEntry(0, "service", "username", "password"));
+    }
+    TS_ASSERT_EQUALS(vault.getEntryCount(), 0);
+    TS_ASSERT(!vault.isInBatch());
+
+    {
+      Vault::Transaction transaction(vault);
+      int id = vault.addEntry(PasswordEntry(0, "service", "username", "password"));
+      vault.addEntry(PasswordEntry(0, "service2", "username2", "password2"));
+      vault.deleteEntry(id);
+      transaction.commit();
+    }
+    vault.close();
+
+    Vault reopened(testVaultFile);
+    reopened.open(testPassword);
+    TS_ASSERT_EQUALS(reopened.getEntryCount(), 1);
+    TS_ASSERT_EQUALS(reopened.getAllEntries()[0].getService(), "service2");
+  }
+
+  void testChangeMasterPasswordRewritesHeaderOnly() {
+    {
+      Vault vault(testVaultFile);
+      vault.create(testPassword);
+      for (int i = 0; i < 20; ++i) {
+        vault.addEntry(PasswordEntry(0, "Service" + std::to_string(i), "user", "pass"));
+      }
+      vault.compact();
+    }
+
+    std::ifstream before(testVaultFile, std::ios::binary);
+    std::string oldBytes((std::istreambuf_iterator<char>(before)), std::istreambuf_iterator<char>());
+    before.close();
+
+    {
+      Vault vault(testVaultFile);
+      vault.open(testPassword);
+      vault.changeMasterPassword("NewPassword456");
+    }
+
+    // entry records untouched, only the 128 byte header changed
+    std::ifstream after(testVaultFile, std::ios::binary);
+    std::string newBytes((std::istreambuf_iterator<char>(after)), std::istreambuf_iterator<char>());
+    TS_ASSERT_EQUALS(newBytes.size(), oldBytes.size());
+    TS_ASSERT_EQUALS(newBytes.substr(128), oldBytes.substr(128));
+    TS_ASSERT_DIFFERS(newBytes.substr(0, 128), oldBytes.substr(0, 128));
+
+    Vault oldPassword(testVaultFile);
+    TS_ASSERT_THROWS(oldPassword.open(testPassword), InvalidPasswordException);
+
+    Vault vault(testVaultFile);
+    vault.open("NewPassword456");
+    TS_ASSERT_EQUALS(vault.getEntryCount(), 20);
+    TS_ASSERT(!std::filesystem::exists(testVaultFile + ".tmp"));
+  }
+
+  void testFailedPasswordChangeKeepsPassword() {
+    Vault vault(testVaultFile);
+    vault.create(testPassword);
+    vault.addEntry(PasswordEntry(0, "GitHub", "alice", "password1"));
+    vault.compact();
+
+    // header cannot be written, the old salt and wrapped key stay in memory
+    std::filesystem::rename(testVaultFile, testVaultFile + ".moved");
+    std::filesystem::create_directory(testVaultFile);
+    TS_ASSERT_THROWS(vault.changeMasterPassword("NewPassword456"), FileException);
+    std::filesystem::remove(testVaultFile);
+    std::filesystem::rename(testVaultFile + ".moved", testVaultFile);
+    vault.addEntry(PasswordEntry(0, "GitLab", "alice", "password2"));
+    vault.compact();
+    vault.close();
+
+    Vault reopened(testVaultFile);
+    reopened.open(testPassword);
+    TS_ASSERT_EQUALS(reopened.getEntryCount(), 2);
+  }
+
+  void testOpenVersion1Vault() {
+    writeVersion1Vault();
+
+    Vault vault(testVaultFile);
+    vault.open(testPassword);
+    TS_ASSERT_EQUALS(vault.getVersion(), 1);
+    TS_ASSERT_EQUALS(vault.getEntryCount(), 1);
+    TS_ASSERT_EQUALS(vault.getEntry(1).getService(), "legacy");
+
+    // first full write moves it to a wrapped data key
+    vault.addEntry(PasswordEntry(0, "service", "username", "password"));
+    vault.compact();
+    TS_ASSERT_EQUALS(vault.getVersion(), 2);
+    vault.close();
+
+    Vault reopened(testVaultFile);
+    reopened.open(testPassword);
+    TS_ASSERT_EQUALS(reopened.getVersion(), 2);
+    TS_ASSERT_EQUALS(reopened.getEntryCount(), 2);
+    TS_ASSERT_EQUALS(reopened.getEntry(1).getPassword(), "password");
+  }
+
+  void testChangeMasterPasswordVersion1() {
+    writeVersion1Vault();
+    {
+      Vault vault(testVaultFile);
+      vault.open(testPassword);
+      vault.changeMasterPassword("NewPassword456");
+    }
+
+    Vault vault(testVaultFile);
+    vault.open("NewPassword456");
+    TS_ASSERT_EQUALS(vault.getVersion(), 2);
+    TS_ASSERT_EQUALS(vault.getEntry(1).getService(), "legacy");
+  }
+
+private:
+  // vault as written before data keys: entries encrypted with the derived key
+  void writeVersion1Vault() {
+    CryptoManager crypto;
+    std::vector<uint8_t> salt = crypto.generateSalt();
+    SecureBytes key = crypto.deriveKey(testPassword, salt);
+
+    std::ofstream file(testVaultFile, std::ios::binary);
+    char header[128] = {0};
+    int version = 1;
+    int iterations = 100000;
+    std::memcpy(header, "OVLT", 4);
+    std::memcpy(header + 4, &version, sizeof(int));
+    std::memcpy(header + 8, salt.data(), 16);
+    std::memcpy(header + 24, &iterations, sizeof(int));
+    SHA256(reinterpret_cast<const unsigned char*>(testPassword.c_str()), testPassword.length(), reinterpret_cast<unsigned char*>(header + 28));
+    file.write(header, sizeof(header));
+
+    int count = 1;
+    std::vector<uint8_t> countBytes(sizeof(int));
+    std::memcpy(countBytes.data(), &count, sizeof(int));
+    // v1 files hold the old text entry format
+    std::string entry = "1|legacy|username|password||||1700000000|1700000000";
+    for (const auto &plain : {countBytes, std::vector<uint8_t>(entry.begin(), entry.end())}) {
+      std::vector<uint8_t> iv = crypto.generateIV();
+      std::vector<uint8_t> encrypted = crypto.encrypt(plain, key, iv);
+      int size = encrypted.size();
+      file.write(reinterpret_cast<const char*>(iv.data()), iv.size());
+      file.write(reinterpret_cast<const char*>(&size), sizeof(int));
+      file.write(reinterpret_cast<const char*>(encrypted.data()), size);
+    }
+  }
 };
 
 #endif